@@ -36,6 +36,7 @@
 struct imsgbuf	client_ibuf;
 struct event	client_event;
 struct event	client_stdin;
+int		client_stdin_file;
 enum {
 	CLIENT_EXIT_NONE,
 	CLIENT_EXIT_DETACHED,
@@ -53,7 +54,7 @@ int		client_attached;
 
 int		client_get_lock(char *);
 int		client_connect(char *, int);
-void		client_send_identify(int);
+void		client_send_identify(int, int);
 int		client_write_one(enum msgtype, int, const void *, size_t);
 int		client_write_server(enum msgtype, const void *, size_t);
 void		client_update_event(void);
@@ -213,6 +214,7 @@ client_main(int argc, char **argv, int flags)
 	enum msgtype		 msg;
 	char			*cause;
 	struct termios		 tio, saved_tio;
+	struct stat		 sb;
 	size_t			 size;
 
 	/* Set up the initial command. */
@@ -220,9 +222,13 @@ client_main(int argc, char **argv, int flags)
 	if (shell_cmd != NULL) {
 		msg = MSG_SHELL;
 		cmdflags = CMD_STARTSERVER;
+	} else if (flags & CLIENT_BATCH) {
+		/* Batch mode has no initial command, only standard input. */
+		msg = MSG_STDIN;
+		cmdflags = CMD_STARTSERVER;
 	} else if (argc == 0) {
 		msg = MSG_COMMAND;
-		cmdflags = CMD_STARTSERVER|CMD_CANTNEST;
+		cmdflags = CMD_STARTSERVER|CMD_CANTNEST|CMD_ENVIRON;
 	} else {
 		msg = MSG_COMMAND;
 
@@ -242,10 +248,20 @@ client_main(int argc, char **argv, int flags)
 				cmdflags |= CMD_STARTSERVER;
 			if (cmd->entry->flags & CMD_CANTNEST)
 				cmdflags |= CMD_CANTNEST;
+			if (cmd->entry->flags & CMD_ENVIRON)
+				cmdflags |= CMD_ENVIRON;
 		}
 		cmd_list_free(cmdlist);
 	}
 
+	/*
+	 * The environment is only used to start new processes, so only send
+	 * it if the command might do that. Control mode clients can run any
+	 * command later, so they always get it.
+	 */
+	if (flags & CLIENT_CONTROL)
+		cmdflags |= CMD_ENVIRON;
+
 	/*
 	 * Check if this could be a nested session, if the command can't nest:
 	 * if the socket path matches $TMUX, this is probably the same server.
@@ -271,15 +287,24 @@ client_main(int argc, char **argv, int flags)
 	setproctitle("client (%s)", socket_path);
 #endif
 	logfile("client");
+	log_debug("using libevent %s (%s)", event_get_version(),
+	    event_get_method());
 
 	/* Create imsg. */
 	imsg_init(&client_ibuf, fd);
 	event_set(&client_event, fd, EV_READ, client_callback, shell_cmd);
 
-	/* Create stdin handler. */
+	/*
+	 * Create stdin handler. Regular files and devices like /dev/null are
+	 * always readable and some event backends (epoll) refuse them, so
+	 * these are read without waiting for the event loop.
+	 */
 	setblocking(STDIN_FILENO, 0);
 	event_set(&client_stdin, STDIN_FILENO, EV_READ|EV_PERSIST,
 	    client_stdin_callback, NULL);
+	if (fstat(STDIN_FILENO, &sb) == 0 && (S_ISREG(sb.st_mode) ||
+	    (S_ISCHR(sb.st_mode) && !isatty(STDIN_FILENO))))
+		client_stdin_file = 1;
 	if (flags & CLIENT_CONTROLCONTROL) {
 		if (tcgetattr(STDIN_FILENO, &saved_tio) != 0) {
 			fprintf(stderr, "tcgetattr failed: %s\n",
@@ -304,7 +329,7 @@ client_main(int argc, char **argv, int flags)
 	set_signals(client_signal);
 
 	/* Send identify messages. */
-	client_send_identify(flags);
+	client_send_identify(flags, cmdflags & CMD_ENVIRON);
 
 	/* Send first command. */
 	if (msg == MSG_COMMAND) {
@@ -359,10 +384,11 @@ client_main(int argc, char **argv, int flags)
 
 /* Send identify messages to server. */
 void
-client_send_identify(int flags)
+client_send_identify(int flags, int sendenv)
 {
 	const char	*s;
-	char		**ss;
+	char		**ss, buf[MAX_IMSGSIZE - IMSG_HEADER_SIZE];
+	size_t		 len, used;
 	int		 fd;
 
 	client_write_one(MSG_IDENTIFY_FLAGS, -1, &flags, sizeof flags);
@@ -383,8 +409,21 @@ client_send_identify(int flags)
 		fatal("dup failed");
 	client_write_one(MSG_IDENTIFY_STDIN, fd, NULL, 0);
 
-	for (ss = environ; *ss != NULL; ss++)
-		client_write_one(MSG_IDENTIFY_ENVIRON, -1, *ss, strlen(*ss) + 1);
+	/* Pack as many variables as fit into each message. */
+	used = 0;
+	for (ss = environ; sendenv && *ss != NULL; ss++) {
+		len = strlen(*ss) + 1;
+		if (len > sizeof buf)
+			continue;
+		if (used + len > sizeof buf) {
+			client_write_one(MSG_IDENTIFY_ENVIRON, -1, buf, used);
+			used = 0;
+		}
+		memcpy(buf + used, *ss, len);
+		used += len;
+	}
+	if (used != 0)
+		client_write_one(MSG_IDENTIFY_ENVIRON, -1, buf, used);
 
 	client_write_one(MSG_IDENTIFY_DONE, -1, NULL, 0);
 
@@ -520,6 +559,8 @@ client_stdin_callback(unused int fd, unused short events, unused void *data1)
 	client_write_server(MSG_STDIN, &data, sizeof data);
 	if (data.size <= 0)
 		event_del(&client_stdin);
+	else if (client_stdin_file)
+		event_active(&client_stdin, EV_READ, 1);
 	client_update_event();
 }
 
@@ -548,8 +589,6 @@ client_dispatch_wait(void *data0)
 	struct imsg		 imsg;
 	char			*data;
 	ssize_t			 n, datalen;
-	struct msg_stdout_data	 stdoutdata;
-	struct msg_stderr_data	 stderrdata;
 	int			 retval;
 
 	for (;;) {
@@ -585,23 +624,16 @@ client_dispatch_wait(void *data0)
 			if (datalen != 0)
 				fatalx("bad MSG_STDIN size");
 
-			event_add(&client_stdin, NULL);
+			if (client_stdin_file)
+				event_active(&client_stdin, EV_READ, 1);
+			else
+				event_add(&client_stdin, NULL);
 			break;
 		case MSG_STDOUT:
-			if (datalen != sizeof stdoutdata)
-				fatalx("bad MSG_STDOUT size");
-			memcpy(&stdoutdata, data, sizeof stdoutdata);
-
-			client_write(STDOUT_FILENO, stdoutdata.data,
-			    stdoutdata.size);
+			client_write(STDOUT_FILENO, data, datalen);
 			break;
 		case MSG_STDERR:
-			if (datalen != sizeof stderrdata)
-				fatalx("bad MSG_STDERR size");
-			memcpy(&stderrdata, data, sizeof stderrdata);
-
-			client_write(STDERR_FILENO, stderrdata.data,
-			    stderrdata.size);
+			client_write(STDERR_FILENO, data, datalen);
 			break;
 		case MSG_VERSION:
 			if (datalen != 0)
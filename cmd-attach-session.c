@@ -36,7 +36,7 @@ const struct cmd_entry cmd_attach_session_entry = {
 	"attach-session", "attach",
 	"c:drt:", 0, 0,
 	"[-dr] [-c working-directory] " CMD_TARGET_SESSION_USAGE,
-	CMD_CANTNEST|CMD_STARTSERVER,
+	CMD_CANTNEST|CMD_STARTSERVER|CMD_ENVIRON,
 	cmd_attach_session_exec
 };
 
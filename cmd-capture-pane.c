@@ -106,8 +106,11 @@ cmd_capture_pane_history(struct args *args, struct cmd_q *cmdq,
 			}
 			return (xstrdup(""));
 		}
-	} else
+	} else {
+		if (args_has(args, 'S') || args_has(args, 'E'))
+			window_pane_reflow_history(wp);
 		gd = wp->base.grid;
+	}
 
 	Sflag = args_get(args, 'S');
 	if (Sflag != NULL && strcmp(Sflag, "-") == 0)
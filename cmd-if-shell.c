@@ -39,7 +39,7 @@ const struct cmd_entry cmd_if_shell_entry = {
 	"if-shell", "if",
 	"bFt:", 2, 3,
 	"[-bF] " CMD_TARGET_PANE_USAGE " shell-command command [command]",
-	0,
+	CMD_ENVIRON,
 	cmd_if_shell_exec
 };
 
@@ -41,7 +41,7 @@ const struct cmd_entry cmd_new_session_entry = {
 	"[-AdDP] [-c start-directory] [-F format] [-n window-name] "
 	"[-s session-name] " CMD_TARGET_SESSION_USAGE " [-x width] "
 	"[-y height] [command]",
-	CMD_STARTSERVER|CMD_CANTNEST,
+	CMD_STARTSERVER|CMD_CANTNEST|CMD_ENVIRON,
 	cmd_new_session_exec
 };
 
@@ -39,7 +39,7 @@ const struct cmd_entry cmd_new_window_entry = {
 	"ac:dF:kn:Pt:", 0, -1,
 	"[-adkP] [-c start-directory] [-F format] [-n window-name] "
 	CMD_TARGET_WINDOW_USAGE " [command]",
-	0,
+	CMD_ENVIRON,
 	cmd_new_window_exec
 };
 
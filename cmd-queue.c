@@ -100,6 +100,9 @@ cmdq_error(struct cmd_q *cmdq, const char *fmt, ...)
 	msglen = xvasprintf(&msg, fmt, ap);
 	va_end(ap);
 
+	if (cmdq->item != NULL)
+		cmdq->item->error = 1;
+
 	if (c == NULL)
 		cfg_add_cause("%s:%u: %s", cmd->file, cmd->line, msg);
 	else if (c->session == NULL || (c->flags & CLIENT_CONTROL)) {
@@ -124,6 +127,8 @@ cmdq_guard(struct cmd_q *cmdq, const char *guard, int flags)
 
 	if (c == NULL || !(c->flags & CLIENT_CONTROL))
 		return;
+	if (c->flags & CLIENT_BATCH)
+		return;
 
 	evbuffer_add_printf(c->stdout_data, "%%%s %ld %u %d\n", guard,
 	    (long) cmdq->time, cmdq->number, flags);
@@ -158,7 +163,7 @@ cmdq_append(struct cmd_q *cmdq, struct cmd_list *cmdlist)
 int
 cmdq_continue(struct cmd_q *cmdq)
 {
-	struct cmd_q_item	*next;
+	struct cmd_q_item	*item, *next;
 	enum cmd_retval		 retval;
 	int			 empty, flags;
 	char			 s[1024];
@@ -178,9 +183,12 @@ cmdq_continue(struct cmd_q *cmdq)
 
 	do {
 		while (cmdq->cmd != NULL) {
-			cmd_print(cmdq->cmd, s, sizeof s);
-			log_debug("cmdq %p: %s (client %d)", cmdq, s,
-			    cmdq->client != NULL ? cmdq->client->ibuf.fd : -1);
+			if (log_flags & LOG_CMDQ) {
+				cmd_print(cmdq->cmd, s, sizeof s);
+				log_cmdq("cmdq %p: %s (client %d)", cmdq, s,
+				    cmdq->client != NULL ?
+				    cmdq->client->ibuf.fd : -1);
+			}
 
 			cmdq->time = time(NULL);
 			cmdq->number++;
@@ -195,17 +203,27 @@ cmdq_continue(struct cmd_q *cmdq)
 			else
 				cmdq_guard(cmdq, "end", flags);
 
-			if (retval == CMD_RETURN_ERROR)
+			if (retval == CMD_RETURN_ERROR) {
+				cmdq->item->error = 1;
 				break;
+			}
 			if (retval == CMD_RETURN_WAIT)
 				goto out;
 			if (retval == CMD_RETURN_STOP) {
+				/* The rest of the queue is not run. */
+				if (cmdq->itemfn != NULL) {
+					TAILQ_FOREACH(item, &cmdq->queue, qentry)
+						cmdq->itemfn(cmdq,
+						    item != cmdq->item || item->error);
+				}
 				cmdq_flush(cmdq);
 				goto empty;
 			}
 
 			cmdq->cmd = TAILQ_NEXT(cmdq->cmd, qentry);
 		}
+		if (cmdq->itemfn != NULL)
+			cmdq->itemfn(cmdq, cmdq->item->error);
 		next = TAILQ_NEXT(cmdq->item, qentry);
 
 		TAILQ_REMOVE(&cmdq->queue, cmdq->item, qentry);
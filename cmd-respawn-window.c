@@ -33,7 +33,7 @@ const struct cmd_entry cmd_respawn_window_entry = {
 	"respawn-window", "respawnw",
 	"kt:", 0, -1,
 	"[-k] " CMD_TARGET_WINDOW_USAGE " [command]",
-	0,
+	CMD_ENVIRON,
 	cmd_respawn_window_exec
 };
 
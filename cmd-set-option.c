@@ -174,18 +174,32 @@ cmd_set_option_exec(struct cmd *self, struct cmd_q *cmdq)
 			return (CMD_RETURN_ERROR);
 	}
 
-	/* Start or stop timers when automatic-rename changed. */
+	/* Check names when automatic-rename changed. */
 	if (strcmp(oe->name, "automatic-rename") == 0) {
-		for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-			if ((w = ARRAY_ITEM(&windows, i)) == NULL)
-				continue;
+		RB_FOREACH(w, windows, &windows) {
 			if (options_get_number(&w->options, "automatic-rename"))
 				queue_window_name(w);
-			else if (event_initialized(&w->name_timer))
-				evtimer_del(&w->name_timer);
+			else
+				unqueue_window_name(w);
 		}
 	}
 
+	/* Cache the control watermarks as they are checked for every output. */
+	if (strcmp(oe->name, "control-high-watermark") == 0) {
+		control_high_watermark = options_get_number(&global_options,
+		    "control-high-watermark");
+	}
+	if (strcmp(oe->name, "control-low-watermark") == 0) {
+		control_low_watermark = options_get_number(&global_options,
+		    "control-low-watermark");
+	}
+
+	/* Cache redraw-interval as it is checked for every update. */
+	if (strcmp(oe->name, "redraw-interval") == 0) {
+		redraw_interval = options_get_number(&global_options,
+		    "redraw-interval");
+	}
+
 	/* Update sizes and redraw. May not need it but meh. */
 	recalculate_sizes();
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
@@ -62,6 +62,10 @@ cmd_show_messages_server(struct cmd_q *cmdq)
 	cmdq_print(cmdq, "socket path %s", socket_path);
 	cmdq_print(cmdq, "debug level %d", debug_level);
 	cmdq_print(cmdq, "protocol version %d", PROTOCOL_VERSION);
+	cmdq_print(cmdq, "process cache %u hits, %u misses", osdep_cache_hits,
+	    osdep_cache_misses);
+	cmdq_print(cmdq, "alerts %u windows checked in %u loops",
+	    server_window_checks, server_window_loops);
 }
 
 void
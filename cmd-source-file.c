@@ -34,7 +34,7 @@ const struct cmd_entry cmd_source_file_entry = {
 	"source-file", "source",
 	"", 1, 1,
 	"path",
-	0,
+	CMD_ENVIRON,
 	cmd_source_file_exec
 };
 
@@ -83,6 +83,12 @@ typedef uint64_t u_int64_t;
 #endif
 #endif
 
+#ifdef HAVE_LOGIN_TTY
+#ifdef HAVE_UTMP_H
+#include <utmp.h>
+#endif
+#endif
+
 #ifdef HAVE_VIS
 #include <vis.h>
 #else
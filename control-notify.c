@@ -19,41 +19,121 @@
 
 #include <sys/types.h>
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "tmux.h"
 
 #define CONTROL_SHOULD_NOTIFY_CLIENT(c) \
-	((c) != NULL && ((c)->flags & CLIENT_CONTROL))
+	((c) != NULL && ((c)->flags & (CLIENT_CONTROL|CLIENT_BATCH)) == \
+	CLIENT_CONTROL)
+
+/* Each byte of a word set to 0x01 and to 0x80. */
+#define CONTROL_ONES (~0UL / 255)
+#define CONTROL_HIGHS (CONTROL_ONES * 0x80)
+
+size_t	control_notify_span(const u_char *, size_t);
+size_t	control_notify_encode(struct window_pane *, const u_char *, size_t);
+
+/* Encoded %output line, shared by all clients. */
+char	*control_notify_buf;
+size_t	 control_notify_size;
+
+/*
+ * Find the length of the run at the start of buf with no bytes below space
+ * and no backslashes, checking a word at a time.
+ */
+size_t
+control_notify_span(const u_char *buf, size_t len)
+{
+	u_long	x, y;
+	size_t	i = 0;
+
+	while (len - i >= sizeof x) {
+		memcpy(&x, buf + i, sizeof x);
+		y = x ^ (CONTROL_ONES * '\\');
+		if (((x - CONTROL_ONES * ' ') & ~x & CONTROL_HIGHS) != 0)
+			break;
+		if (((y - CONTROL_ONES) & ~y & CONTROL_HIGHS) != 0)
+			break;
+		i += sizeof x;
+	}
+	while (i < len && buf[i] >= ' ' && buf[i] != '\\')
+		i++;
+	return (i);
+}
+
+/* Build the %output line for some pane output and return its length. */
+size_t
+control_notify_encode(struct window_pane *wp, const u_char *buf, size_t len)
+{
+	char	*out;
+	size_t	 size, n;
+	int	 prefix;
+	u_char	 ch;
+
+	/* At most four bytes per input byte, the prefix and a newline. */
+	size = 32 + len * 4;
+	if (size > control_notify_size) {
+		control_notify_buf = xrealloc(control_notify_buf, size);
+		control_notify_size = size;
+	}
+	out = control_notify_buf;
+
+	prefix = xsnprintf(out, 32, "%%output %%%u ", wp->id);
+	out += prefix;
+
+	while (len != 0) {
+		n = control_notify_span(buf, len);
+		memcpy(out, buf, n);
+		out += n;
+		buf += n;
+		len -= n;
+
+		if (len != 0) {
+			ch = *buf++;
+			len--;
+			*out++ = '\\';
+			*out++ = '0' + (ch >> 6);
+			*out++ = '0' + ((ch >> 3) & 7);
+			*out++ = '0' + (ch & 7);
+		}
+	}
+	*out++ = '\n';
+
+	return (out - control_notify_buf);
+}
 
+/*
+ * Write pane output to control clients whose session contains the pane. The
+ * output is only encoded once for all of them.
+ */
 void
-control_notify_input(struct client *c, struct window_pane *wp,
-    struct evbuffer *input)
+control_notify_input(struct window_pane *wp, struct evbuffer *input)
 {
-	u_char		*buf;
-	size_t		 len;
-	struct evbuffer *message;
+	struct client	*c;
+	size_t		 len = 0;
 	u_int		 i;
 
-	if (c->session == NULL)
-	    return;
-
-	buf = EVBUFFER_DATA(input);
-	len = EVBUFFER_LENGTH(input);
-
-	/*
-	 * Only write input if the window pane is linked to a window belonging
-	 * to the client's session.
-	 */
-	if (winlink_find_by_window(&c->session->windows, wp->window) != NULL) {
-		message = evbuffer_new();
-		evbuffer_add_printf(message, "%%output %%%u ", wp->id);
-		for (i = 0; i < len; i++) {
-			if (buf[i] < ' ' || buf[i] == '\\')
-			    evbuffer_add_printf(message, "\\%03o", buf[i]);
-			else
-			    evbuffer_add_printf(message, "%c", buf[i]);
+	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
+		c = ARRAY_ITEM(&clients, i);
+		if (!CONTROL_SHOULD_NOTIFY_CLIENT(c) || c->session == NULL)
+			continue;
+		if (winlink_find_by_window(&c->session->windows,
+		    wp->window) == NULL)
+			continue;
+		if (c->flags & CLIENT_CONTROLPAUSED) {
+			control_pane_changed(c, wp, EVBUFFER_LENGTH(input));
+			continue;
+		}
+
+		if (len == 0) {
+			len = control_notify_encode(wp, EVBUFFER_DATA(input),
+			    EVBUFFER_LENGTH(input));
 		}
-		control_write_buffer(c, message);
-		evbuffer_free(message);
+		evbuffer_add(c->stdout_data, control_notify_buf, len);
+		server_push_stdout(c);
+		control_check_queued(c);
 	}
 }
 
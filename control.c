@@ -26,6 +26,10 @@
 
 #include "tmux.h"
 
+/* Values of control-high-watermark and control-low-watermark. */
+u_int	control_high_watermark;
+u_int	control_low_watermark;
+
 /* Write a line. */
 void
 control_write(struct client *c, const char *fmt, ...)
@@ -49,6 +53,66 @@ control_write_buffer(struct client *c, struct evbuffer *buffer)
 	server_push_stdout(c);
 }
 
+/* Note that pane output was not sent to a paused client. */
+void
+control_pane_changed(struct client *c, struct window_pane *wp, size_t size)
+{
+	u_int	i;
+
+	c->control_dropped += size;
+
+	for (i = 0; i < ARRAY_LENGTH(&c->control_panes); i++) {
+		if (ARRAY_ITEM(&c->control_panes, i) == wp->id)
+			return;
+	}
+	ARRAY_ADD(&c->control_panes, wp->id);
+}
+
+/*
+ * Pause pane output to a client which has more than control-high-watermark
+ * bytes waiting to be written. Once it drains to control-low-watermark, tell
+ * it which panes changed in the meantime so it can refresh them.
+ */
+void
+control_check_queued(struct client *c)
+{
+	struct window_pane	*wp;
+	size_t			 queued, high, low;
+	u_int			 i;
+
+	queued = server_client_queued(c);
+	high = control_high_watermark;
+
+	if (~c->flags & CLIENT_CONTROLPAUSED) {
+		if (high != 0 && queued > high) {
+			log_debug("pausing client %d (%zu queued)",
+			    c->ibuf.fd, queued);
+			c->flags |= CLIENT_CONTROLPAUSED;
+		}
+		return;
+	}
+
+	/* Keep the low watermark below the high so there is some hysteresis. */
+	low = control_low_watermark;
+	if (low >= high)
+		low = high / 2;
+	if (queued > low)
+		return;
+	log_debug("continuing client %d (%zu queued)", c->ibuf.fd, queued);
+	c->flags &= ~CLIENT_CONTROLPAUSED;
+
+	for (i = 0; i < ARRAY_LENGTH(&c->control_panes); i++) {
+		wp = window_pane_find_by_id(ARRAY_ITEM(&c->control_panes, i));
+		if (wp == NULL || c->session == NULL)
+			continue;
+		if (winlink_find_by_window(&c->session->windows,
+		    wp->window) == NULL)
+			continue;
+		control_write(c, "%%pane-changed %%%u", wp->id);
+	}
+	ARRAY_CLEAR(&c->control_panes);
+}
+
 /* Control input callback. Read lines and fire commands. */
 void
 control_callback(struct client *c, int closed, unused void *data)
@@ -88,3 +152,70 @@ control_callback(struct client *c, int closed, unused void *data)
 		free(line);
 	}
 }
+
+/*
+ * Batch input callback. Each line is a request id followed by a command; the
+ * output of every command is returned as one length-prefixed result.
+ */
+void
+control_batch_callback(struct client *c, int closed, unused void *data)
+{
+	char		*line, *id, *cmd, *cause;
+	struct cmd_list	*cmdlist;
+
+	if (closed)
+		c->flags |= CLIENT_EXIT;
+
+	for (;;) {
+		line = evbuffer_readln(c->stdin_data, NULL, EVBUFFER_EOL_LF);
+		if (line == NULL)
+			break;
+		if (*line == '\0') { /* empty line exit */
+			c->flags |= CLIENT_EXIT;
+			break;
+		}
+
+		id = line;
+		cmd = line + strcspn(line, " \t");
+		if (*cmd != '\0')
+			*cmd++ = '\0';
+		cmd += strspn(cmd, " \t");
+
+		cause = NULL;
+		if (cmd_string_parse(cmd, &cmdlist, NULL, 0, &cause) != 0) {
+			evbuffer_add_printf(c->batch_data, "%%result %s 1 %zu\n",
+			    id, cause != NULL ? strlen(cause) + 1 : 0);
+			if (cause != NULL)
+				evbuffer_add_printf(c->batch_data, "%s\n", cause);
+			server_push_stdout(c);
+
+			free(cause);
+		} else {
+			ARRAY_ADD(&c->batch_ids, xstrdup(id));
+			cmdq_run(c->cmdq, cmdlist);
+			cmd_list_free(cmdlist);
+		}
+
+		free(line);
+	}
+}
+
+/* Batch command finished. Send its output with the oldest request id. */
+void
+control_batch_done(struct cmd_q *cmdq, int error)
+{
+	struct client	*c = cmdq->client;
+	char		*id;
+
+	if (ARRAY_EMPTY(&c->batch_ids))
+		return;
+	id = ARRAY_FIRST(&c->batch_ids);
+	ARRAY_REMOVE(&c->batch_ids, 0);
+
+	evbuffer_add_printf(c->batch_data, "%%result %s %d %zu\n", id, error,
+	    EVBUFFER_LENGTH(c->stdout_data));
+	evbuffer_add_buffer(c->batch_data, c->stdout_data);
+	server_push_stdout(c);
+
+	free(id);
+}
@@ -36,11 +36,123 @@
  * string.
  */
 
-int	 format_replace(struct format_tree *, const char *, size_t, char **,
+struct format_key;
+struct format_node;
+struct format_template;
+TAILQ_HEAD(format_nodes, format_node);
+
+int	 format_key_cmp(const void *, const void *);
+const struct format_key *format_key_find(const char *);
+const char *format_find1(struct format_tree *, const char *, int,
+	     const struct format_key *);
+int	 format_scope(const char *);
+void	 format_compile_text(struct format_nodes *, const char *, size_t);
+int	 format_compile_key(struct format_nodes *, const char *, size_t);
+void	 format_compile(struct format_nodes *, const char *);
+void	 format_free_nodes(struct format_nodes *);
+struct format_template *format_get_template(const char *);
+void	 format_append(char **, size_t *, size_t *, const char *, size_t);
+void	 format_append_text(struct format_node *, struct tm *, char **,
 	     size_t *, size_t *);
+void	 format_expand_nodes(struct format_tree *, struct format_nodes *,
+	     struct tm *, char **, size_t *, size_t *);
+char	*format_expand_template(struct format_tree *, struct format_template *,
+	     struct tm *);
 char	*format_get_command(struct window_pane *);
+char	*printflike(1, 2) format_printf(const char *, ...);
+char	*format_time(time_t);
+char	*format_pane_tabs(struct window_pane *);
+
+char	*format_cb_host(struct format_tree *);
+char	*format_cb_host_short(struct format_tree *);
+char	*format_cb_client_height(struct format_tree *);
+char	*format_cb_client_width(struct format_tree *);
+char	*format_cb_client_tty(struct format_tree *);
+char	*format_cb_client_termname(struct format_tree *);
+char	*format_cb_client_created(struct format_tree *);
+char	*format_cb_client_created_string(struct format_tree *);
+char	*format_cb_client_activity(struct format_tree *);
+char	*format_cb_client_activity_string(struct format_tree *);
+char	*format_cb_client_written(struct format_tree *);
+char	*format_cb_client_flushes(struct format_tree *);
+char	*format_cb_client_queued(struct format_tree *);
+char	*format_cb_client_dropped(struct format_tree *);
+char	*format_cb_client_prefix(struct format_tree *);
+char	*format_cb_client_key_table(struct format_tree *);
+char	*format_cb_client_utf8(struct format_tree *);
+char	*format_cb_client_readonly(struct format_tree *);
+char	*format_cb_client_session(struct format_tree *);
+char	*format_cb_client_last_session(struct format_tree *);
+char	*format_cb_session_name(struct format_tree *);
+char	*format_cb_session_windows(struct format_tree *);
+char	*format_cb_session_width(struct format_tree *);
+char	*format_cb_session_height(struct format_tree *);
+char	*format_cb_session_id(struct format_tree *);
+char	*format_cb_session_grouped(struct format_tree *);
+char	*format_cb_session_group(struct format_tree *);
+char	*format_cb_session_created(struct format_tree *);
+char	*format_cb_session_created_string(struct format_tree *);
+char	*format_cb_session_attached(struct format_tree *);
+char	*format_cb_session_many_attached(struct format_tree *);
+char	*format_cb_window_id(struct format_tree *);
+char	*format_cb_window_name(struct format_tree *);
+char	*format_cb_window_width(struct format_tree *);
+char	*format_cb_window_height(struct format_tree *);
+char	*format_cb_window_layout(struct format_tree *);
+char	*format_cb_window_panes(struct format_tree *);
+char	*format_cb_window_zoomed_flag(struct format_tree *);
+char	*format_cb_window_index(struct format_tree *);
+char	*format_cb_window_flags(struct format_tree *);
+char	*format_cb_window_active(struct format_tree *);
+char	*format_cb_window_bell_flag(struct format_tree *);
+char	*format_cb_window_activity_flag(struct format_tree *);
+char	*format_cb_window_silence_flag(struct format_tree *);
+char	*format_cb_window_last_flag(struct format_tree *);
+char	*format_cb_history_size(struct format_tree *);
+char	*format_cb_history_limit(struct format_tree *);
+char	*format_cb_history_bytes(struct format_tree *);
+char	*format_cb_history_cold_size(struct format_tree *);
+char	*format_cb_history_cold_bytes(struct format_tree *);
+char	*format_cb_history_spill_bytes(struct format_tree *);
+char	*format_cb_pane_index(struct format_tree *);
+char	*format_cb_pane_width(struct format_tree *);
+char	*format_cb_pane_height(struct format_tree *);
+char	*format_cb_pane_title(struct format_tree *);
+char	*format_cb_pane_id(struct format_tree *);
+char	*format_cb_pane_active(struct format_tree *);
+char	*format_cb_pane_input_off(struct format_tree *);
+char	*format_cb_pane_dead_status(struct format_tree *);
+char	*format_cb_pane_dead(struct format_tree *);
+char	*format_cb_pane_left(struct format_tree *);
+char	*format_cb_pane_top(struct format_tree *);
+char	*format_cb_pane_right(struct format_tree *);
+char	*format_cb_pane_bottom(struct format_tree *);
+char	*format_cb_pane_in_mode(struct format_tree *);
+char	*format_cb_pane_synchronized(struct format_tree *);
+char	*format_cb_pane_tty(struct format_tree *);
+char	*format_cb_pane_pid(struct format_tree *);
+char	*format_cb_pane_current_path(struct format_tree *);
+char	*format_cb_pane_start_command(struct format_tree *);
+char	*format_cb_pane_current_command(struct format_tree *);
+char	*format_cb_cursor_x(struct format_tree *);
+char	*format_cb_cursor_y(struct format_tree *);
+char	*format_cb_scroll_region_upper(struct format_tree *);
+char	*format_cb_scroll_region_lower(struct format_tree *);
+char	*format_cb_saved_cursor_x(struct format_tree *);
+char	*format_cb_saved_cursor_y(struct format_tree *);
+char	*format_cb_alternate_on(struct format_tree *);
+char	*format_cb_alternate_saved_x(struct format_tree *);
+char	*format_cb_alternate_saved_y(struct format_tree *);
+char	*format_cb_cursor_flag(struct format_tree *);
+char	*format_cb_insert_flag(struct format_tree *);
+char	*format_cb_keypad_cursor_flag(struct format_tree *);
+char	*format_cb_keypad_flag(struct format_tree *);
+char	*format_cb_wrap_flag(struct format_tree *);
+char	*format_cb_mouse_standard_flag(struct format_tree *);
+char	*format_cb_mouse_button_flag(struct format_tree *);
+char	*format_cb_mouse_utf8_flag(struct format_tree *);
+char	*format_cb_pane_tabs(struct format_tree *);
 
-void	 format_defaults_pane_tabs(struct format_tree *, struct window_pane *);
 void	 format_defaults_session(struct format_tree *, struct session *);
 void	 format_defaults_client(struct format_tree *, struct client *);
 void	 format_defaults_winlink(struct format_tree *, struct session *,
@@ -54,14 +166,36 @@ struct format_entry {
 	RB_ENTRY(format_entry)	entry;
 };
 
-/* Tree of format entries. */
+/*
+ * Tree of format entries. Most keys are not added to the tree up front: the
+ * objects they come from are remembered and the value is worked out and
+ * added the first time a key is looked up.
+ */
 struct format_tree {
-	struct window	*w;
-	struct session	*s;
+	struct window		*w;
+	struct session		*s;
+
+	int			 flags;
+#define FORMAT_CLIENT 0x1
+#define FORMAT_SESSION 0x2
+#define FORMAT_WINDOW 0x4
+#define FORMAT_WINLINK 0x8
+#define FORMAT_PANE 0x10
+
+	struct client		*c;
+	struct winlink		*wl;
+	struct window_pane	*wp;
 
 	RB_HEAD(format_rb_tree, format_entry) tree;
 };
 
+/* Key worked out when needed. */
+struct format_key {
+	const char	*key;
+	int		 flag;	/* FORMAT_* the key needs, or 0 */
+	char		*(*cb)(struct format_tree *);
+};
+
 /* Format key-value replacement entry. */
 int	format_cmp(struct format_entry *, struct format_entry *);
 RB_PROTOTYPE(format_rb_tree, format_entry, entry, format_cmp);
@@ -74,6 +208,63 @@ format_cmp(struct format_entry *fe1, struct format_entry *fe2)
 	return (strcmp(fe1->key, fe2->key));
 }
 
+/* Option trees a key may be found in. */
+#define FORMAT_SCOPE_SERVER 0x1
+#define FORMAT_SCOPE_WINDOW 0x2
+#define FORMAT_SCOPE_SESSION 0x4
+#define FORMAT_SCOPE_ALL \
+	(FORMAT_SCOPE_SERVER|FORMAT_SCOPE_WINDOW|FORMAT_SCOPE_SESSION)
+
+/* Compiled template node. */
+enum format_node_type {
+	FORMAT_TEXT,
+	FORMAT_KEY,
+	FORMAT_CONDITIONAL
+};
+struct format_node {
+	enum format_node_type	 type;
+
+	char			*text;	/* literal text or key */
+	size_t			 len;
+	int			 scope;
+	const struct format_key	*fk;
+	u_long			 limit;
+
+	struct format_nodes	 yes;
+	struct format_nodes	 no;
+
+	TAILQ_ENTRY(format_node) entry;
+};
+
+/*
+ * Compiled templates, kept in a tree by template string and in a list with
+ * the most recently used first.
+ */
+#define FORMAT_CACHE_SIZE 128
+struct format_template {
+	char			*fmt;
+	struct format_nodes	 nodes;
+
+	RB_ENTRY(format_template) entry;
+	TAILQ_ENTRY(format_template) lentry;
+};
+RB_HEAD(format_templates, format_template) format_templates =
+    RB_INITIALIZER(format_templates);
+TAILQ_HEAD(format_templates_lru, format_template) format_templates_lru =
+    TAILQ_HEAD_INITIALIZER(format_templates_lru);
+u_int	format_templates_count;
+
+int	format_template_cmp(struct format_template *, struct format_template *);
+RB_PROTOTYPE(format_templates, format_template, entry, format_template_cmp);
+RB_GENERATE(format_templates, format_template, entry, format_template_cmp);
+
+/* Compiled template comparison function. */
+int
+format_template_cmp(struct format_template *ftp1, struct format_template *ftp2)
+{
+	return (strcmp(ftp1->fmt, ftp2->fmt));
+}
+
 /* Single-character uppercase aliases. */
 const char *format_upper[] = {
 	NULL,		/* A */
@@ -134,23 +325,114 @@ const char *format_lower[] = {
 	NULL		/* z */
 };
 
+/* Keys worked out when needed, sorted by name. */
+const struct format_key format_keys[] = {
+	{ "alternate_on", FORMAT_PANE, format_cb_alternate_on },
+	{ "alternate_saved_x", FORMAT_PANE, format_cb_alternate_saved_x },
+	{ "alternate_saved_y", FORMAT_PANE, format_cb_alternate_saved_y },
+	{ "client_activity", FORMAT_CLIENT, format_cb_client_activity },
+	{ "client_activity_string", FORMAT_CLIENT,
+	  format_cb_client_activity_string },
+	{ "client_created", FORMAT_CLIENT, format_cb_client_created },
+	{ "client_created_string", FORMAT_CLIENT,
+	  format_cb_client_created_string },
+	{ "client_dropped", FORMAT_CLIENT, format_cb_client_dropped },
+	{ "client_flushes", FORMAT_CLIENT, format_cb_client_flushes },
+	{ "client_height", FORMAT_CLIENT, format_cb_client_height },
+	{ "client_key_table", FORMAT_CLIENT, format_cb_client_key_table },
+	{ "client_last_session", FORMAT_CLIENT, format_cb_client_last_session },
+	{ "client_prefix", FORMAT_CLIENT, format_cb_client_prefix },
+	{ "client_queued", FORMAT_CLIENT, format_cb_client_queued },
+	{ "client_readonly", FORMAT_CLIENT, format_cb_client_readonly },
+	{ "client_session", FORMAT_CLIENT, format_cb_client_session },
+	{ "client_termname", FORMAT_CLIENT, format_cb_client_termname },
+	{ "client_tty", FORMAT_CLIENT, format_cb_client_tty },
+	{ "client_utf8", FORMAT_CLIENT, format_cb_client_utf8 },
+	{ "client_width", FORMAT_CLIENT, format_cb_client_width },
+	{ "client_written", FORMAT_CLIENT, format_cb_client_written },
+	{ "cursor_flag", FORMAT_PANE, format_cb_cursor_flag },
+	{ "cursor_x", FORMAT_PANE, format_cb_cursor_x },
+	{ "cursor_y", FORMAT_PANE, format_cb_cursor_y },
+	{ "history_bytes", FORMAT_PANE, format_cb_history_bytes },
+	{ "history_cold_bytes", FORMAT_PANE, format_cb_history_cold_bytes },
+	{ "history_cold_size", FORMAT_PANE, format_cb_history_cold_size },
+	{ "history_limit", FORMAT_PANE, format_cb_history_limit },
+	{ "history_size", FORMAT_PANE, format_cb_history_size },
+	{ "history_spill_bytes", FORMAT_PANE, format_cb_history_spill_bytes },
+	{ "host", 0, format_cb_host },
+	{ "host_short", 0, format_cb_host_short },
+	{ "insert_flag", FORMAT_PANE, format_cb_insert_flag },
+	{ "keypad_cursor_flag", FORMAT_PANE, format_cb_keypad_cursor_flag },
+	{ "keypad_flag", FORMAT_PANE, format_cb_keypad_flag },
+	{ "mouse_button_flag", FORMAT_PANE, format_cb_mouse_button_flag },
+	{ "mouse_standard_flag", FORMAT_PANE, format_cb_mouse_standard_flag },
+	{ "mouse_utf8_flag", FORMAT_PANE, format_cb_mouse_utf8_flag },
+	{ "pane_active", FORMAT_PANE, format_cb_pane_active },
+	{ "pane_bottom", FORMAT_PANE, format_cb_pane_bottom },
+	{ "pane_current_command", FORMAT_PANE, format_cb_pane_current_command },
+	{ "pane_current_path", FORMAT_PANE, format_cb_pane_current_path },
+	{ "pane_dead", FORMAT_PANE, format_cb_pane_dead },
+	{ "pane_dead_status", FORMAT_PANE, format_cb_pane_dead_status },
+	{ "pane_height", FORMAT_PANE, format_cb_pane_height },
+	{ "pane_id", FORMAT_PANE, format_cb_pane_id },
+	{ "pane_in_mode", FORMAT_PANE, format_cb_pane_in_mode },
+	{ "pane_index", FORMAT_PANE, format_cb_pane_index },
+	{ "pane_input_off", FORMAT_PANE, format_cb_pane_input_off },
+	{ "pane_left", FORMAT_PANE, format_cb_pane_left },
+	{ "pane_pid", FORMAT_PANE, format_cb_pane_pid },
+	{ "pane_right", FORMAT_PANE, format_cb_pane_right },
+	{ "pane_start_command", FORMAT_PANE, format_cb_pane_start_command },
+	{ "pane_synchronized", FORMAT_PANE, format_cb_pane_synchronized },
+	{ "pane_tabs", FORMAT_PANE, format_cb_pane_tabs },
+	{ "pane_title", FORMAT_PANE, format_cb_pane_title },
+	{ "pane_top", FORMAT_PANE, format_cb_pane_top },
+	{ "pane_tty", FORMAT_PANE, format_cb_pane_tty },
+	{ "pane_width", FORMAT_PANE, format_cb_pane_width },
+	{ "saved_cursor_x", FORMAT_PANE, format_cb_saved_cursor_x },
+	{ "saved_cursor_y", FORMAT_PANE, format_cb_saved_cursor_y },
+	{ "scroll_region_lower", FORMAT_PANE, format_cb_scroll_region_lower },
+	{ "scroll_region_upper", FORMAT_PANE, format_cb_scroll_region_upper },
+	{ "session_attached", FORMAT_SESSION, format_cb_session_attached },
+	{ "session_created", FORMAT_SESSION, format_cb_session_created },
+	{ "session_created_string", FORMAT_SESSION,
+	  format_cb_session_created_string },
+	{ "session_group", FORMAT_SESSION, format_cb_session_group },
+	{ "session_grouped", FORMAT_SESSION, format_cb_session_grouped },
+	{ "session_height", FORMAT_SESSION, format_cb_session_height },
+	{ "session_id", FORMAT_SESSION, format_cb_session_id },
+	{ "session_many_attached", FORMAT_SESSION,
+	  format_cb_session_many_attached },
+	{ "session_name", FORMAT_SESSION, format_cb_session_name },
+	{ "session_width", FORMAT_SESSION, format_cb_session_width },
+	{ "session_windows", FORMAT_SESSION, format_cb_session_windows },
+	{ "window_active", FORMAT_WINLINK, format_cb_window_active },
+	{ "window_activity_flag", FORMAT_WINLINK,
+	  format_cb_window_activity_flag },
+	{ "window_bell_flag", FORMAT_WINLINK, format_cb_window_bell_flag },
+	{ "window_flags", FORMAT_WINLINK, format_cb_window_flags },
+	{ "window_height", FORMAT_WINDOW, format_cb_window_height },
+	{ "window_id", FORMAT_WINDOW, format_cb_window_id },
+	{ "window_index", FORMAT_WINLINK, format_cb_window_index },
+	{ "window_last_flag", FORMAT_WINLINK, format_cb_window_last_flag },
+	{ "window_layout", FORMAT_WINDOW, format_cb_window_layout },
+	{ "window_name", FORMAT_WINDOW, format_cb_window_name },
+	{ "window_panes", FORMAT_WINDOW, format_cb_window_panes },
+	{ "window_silence_flag", FORMAT_WINLINK,
+	  format_cb_window_silence_flag },
+	{ "window_width", FORMAT_WINDOW, format_cb_window_width },
+	{ "window_zoomed_flag", FORMAT_WINDOW, format_cb_window_zoomed_flag },
+	{ "wrap_flag", FORMAT_PANE, format_cb_wrap_flag },
+};
+
 /* Create a new tree. */
 struct format_tree *
 format_create(void)
 {
 	struct format_tree	*ft;
-	char			 host[HOST_NAME_MAX+1], *ptr;
 
 	ft = xcalloc(1, sizeof *ft);
 	RB_INIT(&ft->tree);
 
-	if (gethostname(host, sizeof host) == 0) {
-		format_add(ft, "host", "%s", host);
-		if ((ptr = strchr(host, '.')) != NULL)
-			*ptr = '\0';
-		format_add(ft, "host_short", "%s", host);
-	}
-
 	return (ft);
 }
 
@@ -194,23 +476,56 @@ format_add(struct format_tree *ft, const char *key, const char *fmt, ...)
 	}
 }
 
+/* Compare format keys. */
+int
+format_key_cmp(const void *key, const void *value)
+{
+	const struct format_key	*fk = value;
+
+	return (strcmp(key, fk->key));
+}
+
+/* Find a key that can be worked out when needed. */
+const struct format_key *
+format_key_find(const char *key)
+{
+	return (bsearch(key, format_keys, nitems(format_keys),
+	    sizeof format_keys[0], format_key_cmp));
+}
+
 /* Find a format entry. */
 const char *
 format_find(struct format_tree *ft, const char *key)
+{
+	return (format_find1(ft, key, FORMAT_SCOPE_ALL, format_key_find(key)));
+}
+
+/*
+ * Find a format entry, only checking the option trees given by scope. If the
+ * key is not in the tree but can be worked out, do so and add it.
+ */
+const char *
+format_find1(struct format_tree *ft, const char *key, int scope,
+    const struct format_key *fk)
 {
 	struct format_entry	*fe, fe_find;
-	struct options_entry	*o;
+	struct options_entry	*o = NULL;
 	static char		 s[16];
 
-	o = options_find(&global_options, key);
-	if (o == NULL && ft->w != NULL)
-		o = options_find(&ft->w->options, key);
-	if (o == NULL)
-		o = options_find(&global_w_options, key);
-	if (o == NULL && ft->s != NULL)
-		o = options_find(&ft->s->options, key);
-	if (o == NULL)
-		o = options_find(&global_s_options, key);
+	if (scope & FORMAT_SCOPE_SERVER)
+		o = options_find(&global_options, key);
+	if (scope & FORMAT_SCOPE_WINDOW) {
+		if (o == NULL && ft->w != NULL)
+			o = options_find(&ft->w->options, key);
+		if (o == NULL)
+			o = options_find(&global_w_options, key);
+	}
+	if (scope & FORMAT_SCOPE_SESSION) {
+		if (o == NULL && ft->s != NULL)
+			o = options_find(&ft->s->options, key);
+		if (o == NULL)
+			o = options_find(&global_s_options, key);
+	}
 	if (o != NULL) {
 		switch (o->type) {
 		case OPTIONS_STRING:
@@ -225,23 +540,71 @@ format_find(struct format_tree *ft, const char *key)
 
 	fe_find.key = (char *) key;
 	fe = RB_FIND(format_rb_tree, &ft->tree, &fe_find);
-	if (fe == NULL)
+	if (fe != NULL)
+		return (fe->value);
+
+	if (fk == NULL || (fk->flag != 0 && (ft->flags & fk->flag) == 0))
 		return (NULL);
+	fe = xmalloc(sizeof *fe);
+	fe->key = xstrdup(key);
+	fe->value = fk->cb(ft);
+	RB_INSERT(format_rb_tree, &ft->tree, fe);
 	return (fe->value);
 }
 
+/* Work out which option trees could hold a key. */
+int
+format_scope(const char *key)
+{
+	const struct options_table_entry	*oe;
+	int					 scope = 0;
+
+	if (*key == '@')
+		return (FORMAT_SCOPE_ALL);
+
+	for (oe = server_options_table; oe->name != NULL; oe++) {
+		if (strcmp(oe->name, key) == 0)
+			scope |= FORMAT_SCOPE_SERVER;
+	}
+	for (oe = window_options_table; oe->name != NULL; oe++) {
+		if (strcmp(oe->name, key) == 0)
+			scope |= FORMAT_SCOPE_WINDOW;
+	}
+	for (oe = session_options_table; oe->name != NULL; oe++) {
+		if (strcmp(oe->name, key) == 0)
+			scope |= FORMAT_SCOPE_SESSION;
+	}
+	return (scope);
+}
+
+/* Add literal text to a compiled template, joining it to any previous text. */
+void
+format_compile_text(struct format_nodes *nodes, const char *text, size_t len)
+{
+	struct format_node	*fn;
+
+	fn = TAILQ_LAST(nodes, format_nodes);
+	if (fn == NULL || fn->type != FORMAT_TEXT) {
+		fn = xcalloc(1, sizeof *fn);
+		fn->type = FORMAT_TEXT;
+		TAILQ_INSERT_TAIL(nodes, fn, entry);
+	}
+	fn->text = xrealloc(fn->text, fn->len + len + 1);
+	memcpy(fn->text + fn->len, text, len);
+	fn->len += len;
+	fn->text[fn->len] = '\0';
+}
+
 /*
- * Replace a key/value pair in buffer. #{blah} is expanded directly,
- * #{?blah,a,b} is replace with a if blah exists and is nonzero else b.
+ * Compile a key. #{blah} is expanded directly, #{?blah,a,b} is replaced with a
+ * if blah exists and is nonzero else b.
  */
 int
-format_replace(struct format_tree *ft, const char *key, size_t keylen,
-    char **buf, size_t *len, size_t *off)
+format_compile_key(struct format_nodes *nodes, const char *key, size_t keylen)
 {
-	char		*copy, *copy0, *endptr, *ptr, *saved, *trimmed;
-	const char	*value;
-	size_t		 valuelen;
-	u_long		 limit = 0;
+	struct format_node	*fn;
+	char			*copy, *copy0, *endptr, *ptr, *yes, *no;
+	u_long			 limit = 0;
 
 	/* Make a copy of the key. */
 	copy0 = copy = xmalloc(keylen + 1);
@@ -270,118 +633,73 @@ format_replace(struct format_tree *ft, const char *key, size_t keylen,
 	}
 
 	/*
-	 * Is this a conditional? If so, check it exists and extract either the
-	 * first or second element. If not, look up the key directly.
+	 * Is this a conditional? If so, split off the key and the two choices
+	 * and compile them separately.
 	 */
+	fn = xcalloc(1, sizeof *fn);
+	fn->limit = limit;
+	TAILQ_INIT(&fn->yes);
+	TAILQ_INIT(&fn->no);
 	if (*copy == '?') {
 		ptr = strchr(copy, ',');
 		if (ptr == NULL)
-			goto fail;
+			goto fail_node;
 		*ptr = '\0';
 
-		value = format_find(ft, copy + 1);
-		if (value != NULL && *value != '\0' &&
-		    (value[0] != '0' || value[1] != '\0')) {
-			value = ptr + 1;
-			ptr = strchr(value, ',');
-			if (ptr == NULL)
-				goto fail;
-			*ptr = '\0';
-		} else {
-			ptr = strchr(ptr + 1, ',');
-			if (ptr == NULL)
-				goto fail;
-			value = ptr + 1;
-		}
-		saved = format_expand(ft, value);
-		value = saved;
-	} else {
-		value = format_find(ft, copy);
-		if (value == NULL)
-			value = "";
-		saved = NULL;
-	}
-
-	/* Truncate the value if needed. */
-	if (limit != 0) {
-		value = trimmed = utf8_trimcstr(value, limit);
-		free(saved);
-		saved = trimmed;
-	}
-	valuelen = strlen(value);
+		yes = ptr + 1;
+		ptr = strchr(yes, ',');
+		if (ptr == NULL)
+			goto fail_node;
+		*ptr = '\0';
+		no = ptr + 1;
 
-	/* Expand the buffer and copy in the value. */
-	while (*len - *off < valuelen + 1) {
-		*buf = xreallocarray(*buf, 2, *len);
-		*len *= 2;
+		fn->type = FORMAT_CONDITIONAL;
+		fn->text = xstrdup(copy + 1);
+		format_compile(&fn->yes, yes);
+		format_compile(&fn->no, no);
+	} else {
+		fn->type = FORMAT_KEY;
+		fn->text = xstrdup(copy);
 	}
-	memcpy(*buf + *off, value, valuelen);
-	*off += valuelen;
+	fn->len = strlen(fn->text);
+	fn->scope = format_scope(fn->text);
+	fn->fk = format_key_find(fn->text);
+	TAILQ_INSERT_TAIL(nodes, fn, entry);
 
-	free(saved);
 	free(copy0);
 	return (0);
 
+fail_node:
+	free(fn);
 fail:
 	free(copy0);
 	return (-1);
 }
 
-/* Expand keys in a template, passing through strftime first. */
-char *
-format_expand_time(struct format_tree *ft, const char *fmt, time_t t)
-{
-	char		*tmp, *expanded;
-	size_t		 tmplen;
-	struct tm	*tm;
-
-	if (fmt == NULL)
-		return (xstrdup(""));
-
-	tm = localtime(&t);
-
-	tmp = NULL;
-	tmplen = strlen(fmt);
-
-	do {
-		tmp = xreallocarray(tmp, 2, tmplen);
-		tmplen *= 2;
-	} while (strftime(tmp, tmplen, fmt, tm) == 0);
-
-	expanded = format_expand(ft, tmp);
-	free(tmp);
-
-	return (expanded);
-}
-
-/* Expand keys in a template. */
-char *
-format_expand(struct format_tree *ft, const char *fmt)
+/* Compile a template into a list of nodes. */
+void
+format_compile(struct format_nodes *nodes, const char *fmt)
 {
-	char		*buf;
 	const char	*ptr, *s;
-	size_t		 off, len, n;
-	int     	 ch, brackets;
-
-	if (fmt == NULL)
-		return (xstrdup(""));
-
-	len = 64;
-	buf = xmalloc(len);
-	off = 0;
+	size_t		 n;
+	int		 ch, brackets;
 
 	while (*fmt != '\0') {
 		if (*fmt != '#') {
-			while (len - off < 2) {
-				buf = xreallocarray(buf, 2, len);
-				len *= 2;
-			}
-			buf[off++] = *fmt++;
+			n = strcspn(fmt, "#");
+			format_compile_text(nodes, fmt, n);
+			fmt += n;
 			continue;
 		}
 		fmt++;
 
-		ch = (u_char) *fmt++;
+		ch = (u_char) *fmt;
+		if (ch == '\0') {
+			format_compile_text(nodes, "#", 1);
+			break;
+		}
+		fmt++;
+
 		switch (ch) {
 		case '{':
 			brackets = 1;
@@ -395,16 +713,12 @@ format_expand(struct format_tree *ft, const char *fmt)
 				break;
 			n = ptr - fmt;
 
-			if (format_replace(ft, fmt, n, &buf, &len, &off) != 0)
+			if (format_compile_key(nodes, fmt, n) != 0)
 				break;
 			fmt += n + 1;
 			continue;
 		case '#':
-			while (len - off < 2) {
-				buf = xreallocarray(buf, 2, len);
-				len *= 2;
-			}
-			buf[off++] = '#';
+			format_compile_text(nodes, "#", 1);
 			continue;
 		default:
 			s = NULL;
@@ -413,209 +727,257 @@ format_expand(struct format_tree *ft, const char *fmt)
 			else if (ch >= 'a' && ch <= 'z')
 				s = format_lower[ch - 'a'];
 			if (s == NULL) {
-				while (len - off < 3) {
-					buf = xreallocarray(buf, 2, len);
-					len *= 2;
-				}
-				buf[off++] = '#';
-				buf[off++] = ch;
+				format_compile_text(nodes, fmt - 2, 2);
 				continue;
 			}
-			n = strlen(s);
-			if (format_replace(ft, s, n, &buf, &len, &off) != 0)
+			if (format_compile_key(nodes, s, strlen(s)) != 0)
 				break;
 			continue;
 		}
 
 		break;
 	}
-	buf[off] = '\0';
-
-	return (buf);
 }
 
-/* Get command name for format. */
-char *
-format_get_command(struct window_pane *wp)
+/* Free a list of compiled nodes. */
+void
+format_free_nodes(struct format_nodes *nodes)
 {
-	char	*cmd, *out;
+	struct format_node	*fn, *fn1;
 
-	cmd = osdep_get_name(wp->fd, wp->tty);
-	if (cmd == NULL || *cmd == '\0') {
-		free(cmd);
-		cmd = cmd_stringify_argv(wp->argc, wp->argv);
-		if (cmd == NULL || *cmd == '\0') {
-			free(cmd);
-			cmd = xstrdup(wp->shell);
+	TAILQ_FOREACH_SAFE(fn, nodes, entry, fn1) {
+		TAILQ_REMOVE(nodes, fn, entry);
+		if (fn->type == FORMAT_CONDITIONAL) {
+			format_free_nodes(&fn->yes);
+			format_free_nodes(&fn->no);
 		}
+		free(fn->text);
+		free(fn);
 	}
-	out = parse_window_name(cmd);
-	free(cmd);
-	return (out);
 }
 
-/* Set defaults for any of arguments that are not NULL. */
-void
-format_defaults(struct format_tree *ft, struct client *c, struct session *s,
-    struct winlink *wl, struct window_pane *wp)
+/*
+ * Look up a compiled template, compiling it and adding it to the cache if it
+ * is not already there. The least recently used template is dropped when the
+ * cache is full.
+ */
+struct format_template *
+format_get_template(const char *fmt)
 {
-	if (s == NULL && c != NULL)
-		s = c->session;
-	if (wl == NULL && s != NULL)
-		wl = s->curw;
-	if (wp == NULL && wl != NULL)
-		wp = wl->window->active;
+	struct format_template	*ftp, ftp_find;
+
+	ftp_find.fmt = (char *) fmt;
+	ftp = RB_FIND(format_templates, &format_templates, &ftp_find);
+	if (ftp != NULL) {
+		if (ftp != TAILQ_FIRST(&format_templates_lru)) {
+			TAILQ_REMOVE(&format_templates_lru, ftp, lentry);
+			TAILQ_INSERT_HEAD(&format_templates_lru, ftp, lentry);
+		}
+		return (ftp);
+	}
 
-	if (c != NULL)
-		format_defaults_client(ft, c);
-	if (s != NULL)
-		format_defaults_session(ft, s);
-	if (s != NULL && wl != NULL)
-		format_defaults_winlink(ft, s, wl);
-	if (wp != NULL)
-		format_defaults_pane(ft, wp);
+	if (format_templates_count == FORMAT_CACHE_SIZE) {
+		ftp = TAILQ_LAST(&format_templates_lru, format_templates_lru);
+		TAILQ_REMOVE(&format_templates_lru, ftp, lentry);
+		RB_REMOVE(format_templates, &format_templates, ftp);
+		format_free_nodes(&ftp->nodes);
+		free(ftp->fmt);
+		free(ftp);
+		format_templates_count--;
+	}
+
+	ftp = xmalloc(sizeof *ftp);
+	ftp->fmt = xstrdup(fmt);
+	TAILQ_INIT(&ftp->nodes);
+	format_compile(&ftp->nodes, fmt);
+
+	RB_INSERT(format_templates, &format_templates, ftp);
+	TAILQ_INSERT_HEAD(&format_templates_lru, ftp, lentry);
+	format_templates_count++;
+
+	return (ftp);
 }
 
-/* Set default format keys for a session. */
+/* Append to the expansion buffer. */
 void
-format_defaults_session(struct format_tree *ft, struct session *s)
+format_append(char **buf, size_t *len, size_t *off, const char *s, size_t n)
 {
-	struct session_group	*sg;
-	char			*tim;
-	time_t			 t;
-
-	ft->s = s;
-
-	format_add(ft, "session_name", "%s", s->name);
-	format_add(ft, "session_windows", "%u", winlink_count(&s->windows));
-	format_add(ft, "session_width", "%u", s->sx);
-	format_add(ft, "session_height", "%u", s->sy);
-	format_add(ft, "session_id", "$%u", s->id);
+	while (*len - *off < n + 1) {
+		*buf = xreallocarray(*buf, 2, *len);
+		*len *= 2;
+	}
+	memcpy(*buf + *off, s, n);
+	*off += n;
+}
 
-	sg = session_group_find(s);
-	format_add(ft, "session_grouped", "%d", sg != NULL);
-	if (sg != NULL)
-		format_add(ft, "session_group", "%u", session_group_index(sg));
+/* Append literal text, passing it through strftime if needed. */
+void
+format_append_text(struct format_node *fn, struct tm *tm, char **buf,
+    size_t *len, size_t *off)
+{
+	char	*tmp;
+	size_t	 tmplen, n;
 
-	t = s->creation_time.tv_sec;
-	format_add(ft, "session_created", "%lld", (long long) t);
-	tim = ctime(&t);
-	*strchr(tim, '\n') = '\0';
-	format_add(ft, "session_created_string", "%s", tim);
+	if (tm == NULL || memchr(fn->text, '%', fn->len) == NULL) {
+		format_append(buf, len, off, fn->text, fn->len);
+		return;
+	}
 
-	format_add(ft, "session_attached", "%u", s->attached);
-	format_add(ft, "session_many_attached", "%u", s->attached > 1);
+	tmp = NULL;
+	tmplen = fn->len;
+	do {
+		tmp = xreallocarray(tmp, 2, tmplen);
+		tmplen *= 2;
+		n = strftime(tmp, tmplen, fn->text, tm);
+	} while (n == 0 && tmplen < (fn->len + 1) * 64);
+	format_append(buf, len, off, tmp, n);
+	free(tmp);
 }
 
-/* Set default format keys for a client. */
+/* Expand a list of compiled nodes into a buffer. */
 void
-format_defaults_client(struct format_tree *ft, struct client *c)
+format_expand_nodes(struct format_tree *ft, struct format_nodes *nodes,
+    struct tm *tm, char **buf, size_t *len, size_t *off)
 {
-	char		*tim;
-	time_t		 t;
-	struct session	*s;
-
-	if (ft->s == NULL)
-		ft->s = c->session;
+	struct format_node	*fn;
+	const char		*value;
+	char			*saved, *trimmed;
+	size_t			 start;
+
+	TAILQ_FOREACH(fn, nodes, entry) {
+		if (fn->type == FORMAT_TEXT) {
+			format_append_text(fn, tm, buf, len, off);
+			continue;
+		}
 
-	format_add(ft, "client_height", "%u", c->tty.sy);
-	format_add(ft, "client_width", "%u", c->tty.sx);
-	if (c->tty.path != NULL)
-		format_add(ft, "client_tty", "%s", c->tty.path);
-	if (c->tty.termname != NULL)
-		format_add(ft, "client_termname", "%s", c->tty.termname);
+		value = format_find1(ft, fn->text, fn->scope, fn->fk);
+		if (fn->type == FORMAT_CONDITIONAL) {
+			start = *off;
+			if (value != NULL && *value != '\0' &&
+			    (value[0] != '0' || value[1] != '\0')) {
+				format_expand_nodes(ft, &fn->yes, tm, buf, len,
+				    off);
+			} else
+				format_expand_nodes(ft, &fn->no, tm, buf, len, off);
+			if (fn->limit == 0)
+				continue;
 
-	t = c->creation_time.tv_sec;
-	format_add(ft, "client_created", "%lld", (long long) t);
-	tim = ctime(&t);
-	*strchr(tim, '\n') = '\0';
-	format_add(ft, "client_created_string", "%s", tim);
+			/* Take the expanded choice back out to trim it. */
+			(*buf)[*off] = '\0';
+			saved = xstrdup(*buf + start);
+			*off = start;
+			value = saved;
+		} else {
+			if (value == NULL)
+				value = "";
+			if (fn->limit == 0) {
+				format_append(buf, len, off, value,
+				    strlen(value));
+				continue;
+			}
+			saved = NULL;
+		}
 
-	t = c->activity_time.tv_sec;
-	format_add(ft, "client_activity", "%lld", (long long) t);
-	tim = ctime(&t);
-	*strchr(tim, '\n') = '\0';
-	format_add(ft, "client_activity_string", "%s", tim);
+		/* Truncate the value. */
+		trimmed = utf8_trimcstr(value, fn->limit);
+		format_append(buf, len, off, trimmed, strlen(trimmed));
+		free(trimmed);
+		free(saved);
+	}
+}
 
-	format_add(ft, "client_prefix", strcmp(c->keytable->name, "root") ? "1": "0");
-	format_add(ft, "client_key_table", "%s", c->keytable->name);
+/* Expand a compiled template. */
+char *
+format_expand_template(struct format_tree *ft, struct format_template *ftp,
+    struct tm *tm)
+{
+	char	*buf;
+	size_t	 off, len;
 
-	if (c->tty.flags & TTY_UTF8)
-		format_add(ft, "client_utf8", "%d", 1);
-	else
-		format_add(ft, "client_utf8", "%d", 0);
+	len = 64;
+	buf = xmalloc(len);
+	off = 0;
 
-	if (c->flags & CLIENT_READONLY)
-		format_add(ft, "client_readonly", "%d", 1);
-	else
-		format_add(ft, "client_readonly", "%d", 0);
+	format_expand_nodes(ft, &ftp->nodes, tm, &buf, &len, &off);
+	buf[off] = '\0';
 
-	s = c->session;
-	if (s != NULL)
-		format_add(ft, "client_session", "%s", s->name);
-	s = c->last_session;
-	if (s != NULL && session_alive(s))
-		format_add(ft, "client_last_session", "%s", s->name);
+	return (buf);
 }
 
-/* Set default format keys for a window. */
-void
-format_defaults_window(struct format_tree *ft, struct window *w)
+/* Expand keys in a template, passing text through strftime first. */
+char *
+format_expand_time(struct format_tree *ft, const char *fmt, time_t t)
 {
-	char	*layout;
+	struct tm	*tm;
 
-	ft->w = w;
+	if (fmt == NULL)
+		return (xstrdup(""));
 
-	layout = layout_dump(w);
+	tm = localtime(&t);
+	return (format_expand_template(ft, format_get_template(fmt), tm));
+}
 
-	format_add(ft, "window_id", "@%u", w->id);
-	format_add(ft, "window_name", "%s", w->name);
-	format_add(ft, "window_width", "%u", w->sx);
-	format_add(ft, "window_height", "%u", w->sy);
-	format_add(ft, "window_layout", "%s", layout);
-	format_add(ft, "window_panes", "%u", window_count_panes(w));
-	format_add(ft, "window_zoomed_flag", "%u",
-	    !!(w->flags & WINDOW_ZOOMED));
+/* Expand keys in a template. */
+char *
+format_expand(struct format_tree *ft, const char *fmt)
+{
+	if (fmt == NULL)
+		return (xstrdup(""));
 
-	free(layout);
+	return (format_expand_template(ft, format_get_template(fmt), NULL));
 }
 
-/* Set default format keys for a winlink. */
-void
-format_defaults_winlink(struct format_tree *ft, struct session *s,
-    struct winlink *wl)
+/* Get command name for format. */
+char *
+format_get_command(struct window_pane *wp)
 {
-	struct window	*w = wl->window;
-	char		*flags;
+	char	*cmd, *out;
 
-	if (ft->w == NULL)
-		ft->w = wl->window;
+	cmd = osdep_get_name(wp->fd, wp->tty);
+	if (cmd == NULL || *cmd == '\0') {
+		free(cmd);
+		cmd = cmd_stringify_argv(wp->argc, wp->argv);
+		if (cmd == NULL || *cmd == '\0') {
+			free(cmd);
+			cmd = xstrdup(wp->shell);
+		}
+	}
+	out = parse_window_name(cmd);
+	free(cmd);
+	return (out);
+}
 
-	flags = window_printable_flags(s, wl);
+/* Print a format value. */
+char *
+format_printf(const char *fmt, ...)
+{
+	va_list	 ap;
+	char	*value;
 
-	format_defaults_window(ft, w);
+	va_start(ap, fmt);
+	xvasprintf(&value, fmt, ap);
+	va_end(ap);
 
-	format_add(ft, "window_index", "%d", wl->idx);
-	format_add(ft, "window_flags", "%s", flags);
-	format_add(ft, "window_active", "%d", wl == s->curw);
+	return (value);
+}
 
-	format_add(ft, "window_bell_flag", "%u",
-	    !!(wl->flags & WINLINK_BELL));
-	format_add(ft, "window_activity_flag", "%u",
-	    !!(wl->flags & WINLINK_ACTIVITY));
-	format_add(ft, "window_silence_flag", "%u",
-	    !!(wl->flags & WINLINK_SILENCE));
-	format_add(ft, "window_last_flag", "%u",
-	    !!(wl == TAILQ_FIRST(&s->lastw)));
+/* Print a time for format. */
+char *
+format_time(time_t t)
+{
+	char	*tim;
 
-	free(flags);
+	tim = xstrdup(ctime(&t));
+	*strchr(tim, '\n') = '\0';
+	return (tim);
 }
 
-/* Add window pane tabs. */
-void
-format_defaults_pane_tabs(struct format_tree *ft, struct window_pane *wp)
+/* Get window pane tabs. */
+char *
+format_pane_tabs(struct window_pane *wp)
 {
 	struct evbuffer	*buffer;
+	char		*value;
 	u_int		 i;
 
 	buffer = evbuffer_new();
@@ -628,106 +990,757 @@ format_defaults_pane_tabs(struct format_tree *ft, struct window_pane *wp)
 		evbuffer_add_printf(buffer, "%d", i);
 	}
 
-	format_add(ft, "pane_tabs", "%.*s", (int) EVBUFFER_LENGTH(buffer),
+	xasprintf(&value, "%.*s", (int) EVBUFFER_LENGTH(buffer),
 	    EVBUFFER_DATA(buffer));
 	evbuffer_free(buffer);
+	return (value);
 }
 
-/* Set default format keys for a window pane. */
-void
-format_defaults_pane(struct format_tree *ft, struct window_pane *wp)
+/* Callback for host. */
+char *
+format_cb_host(unused struct format_tree *ft)
 {
-	struct grid		*gd = wp->base.grid;
-	struct grid_line	*gl;
-	unsigned long long	 size;
-	u_int			 i, idx;
-	char			*cmd, *cwd;
-	int			 status;
+	char	host[HOST_NAME_MAX+1];
 
-	if (ft->w == NULL)
-		ft->w = wp->window;
+	if (gethostname(host, sizeof host) != 0)
+		return (NULL);
+	return (xstrdup(host));
+}
 
-	size = 0;
-	for (i = 0; i < gd->hsize; i++) {
-		gl = &gd->linedata[i];
-		size += gl->cellsize * sizeof *gl->celldata;
-	}
-	size += gd->hsize * sizeof *gd->linedata;
-	format_add(ft, "history_size", "%u", gd->hsize);
-	format_add(ft, "history_limit", "%u", gd->hlimit);
-	format_add(ft, "history_bytes", "%llu", size);
+/* Callback for host_short. */
+char *
+format_cb_host_short(unused struct format_tree *ft)
+{
+	char	host[HOST_NAME_MAX+1], *cp;
+
+	if (gethostname(host, sizeof host) != 0)
+		return (NULL);
+	if ((cp = strchr(host, '.')) != NULL)
+		*cp = '\0';
+	return (xstrdup(host));
+}
+
+/* Callback for client_height. */
+char *
+format_cb_client_height(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->c->tty.sy));
+}
+
+/* Callback for client_width. */
+char *
+format_cb_client_width(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->c->tty.sx));
+}
+
+/* Callback for client_tty. */
+char *
+format_cb_client_tty(struct format_tree *ft)
+{
+	if (ft->c->tty.path == NULL)
+		return (NULL);
+	return (xstrdup(ft->c->tty.path));
+}
+
+/* Callback for client_termname. */
+char *
+format_cb_client_termname(struct format_tree *ft)
+{
+	if (ft->c->tty.termname == NULL)
+		return (NULL);
+	return (xstrdup(ft->c->tty.termname));
+}
+
+/* Callback for client_created. */
+char *
+format_cb_client_created(struct format_tree *ft)
+{
+	return (format_printf("%lld", (long long) ft->c->creation_time.tv_sec));
+}
+
+/* Callback for client_created_string. */
+char *
+format_cb_client_created_string(struct format_tree *ft)
+{
+	return (format_time(ft->c->creation_time.tv_sec));
+}
+
+/* Callback for client_activity. */
+char *
+format_cb_client_activity(struct format_tree *ft)
+{
+	return (format_printf("%lld", (long long) ft->c->activity_time.tv_sec));
+}
+
+/* Callback for client_activity_string. */
+char *
+format_cb_client_activity_string(struct format_tree *ft)
+{
+	return (format_time(ft->c->activity_time.tv_sec));
+}
+
+/* Callback for client_written. */
+char *
+format_cb_client_written(struct format_tree *ft)
+{
+	return (format_printf("%lu", ft->c->tty.written));
+}
+
+/* Callback for client_flushes. */
+char *
+format_cb_client_flushes(struct format_tree *ft)
+{
+	return (format_printf("%lu", ft->c->tty.flushes));
+}
+
+/* Callback for client_queued. */
+char *
+format_cb_client_queued(struct format_tree *ft)
+{
+	return (format_printf("%zu", server_client_queued(ft->c)));
+}
+
+/* Callback for client_dropped. */
+char *
+format_cb_client_dropped(struct format_tree *ft)
+{
+	return (format_printf("%zu", ft->c->control_dropped));
+}
+
+/* Callback for client_prefix. */
+char *
+format_cb_client_prefix(struct format_tree *ft)
+{
+	return (format_printf("%d",
+	    strcmp(ft->c->keytable->name, "root") != 0));
+}
+
+/* Callback for client_key_table. */
+char *
+format_cb_client_key_table(struct format_tree *ft)
+{
+	return (xstrdup(ft->c->keytable->name));
+}
+
+/* Callback for client_utf8. */
+char *
+format_cb_client_utf8(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->c->tty.flags & TTY_UTF8)));
+}
+
+/* Callback for client_readonly. */
+char *
+format_cb_client_readonly(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->c->flags & CLIENT_READONLY)));
+}
+
+/* Callback for client_session. */
+char *
+format_cb_client_session(struct format_tree *ft)
+{
+	if (ft->c->session == NULL)
+		return (NULL);
+	return (xstrdup(ft->c->session->name));
+}
+
+/* Callback for client_last_session. */
+char *
+format_cb_client_last_session(struct format_tree *ft)
+{
+	struct session	*s = ft->c->last_session;
+
+	if (s == NULL || !session_alive(s))
+		return (NULL);
+	return (xstrdup(s->name));
+}
+
+/* Callback for session_name. */
+char *
+format_cb_session_name(struct format_tree *ft)
+{
+	return (xstrdup(ft->s->name));
+}
+
+/* Callback for session_windows. */
+char *
+format_cb_session_windows(struct format_tree *ft)
+{
+	return (format_printf("%u", winlink_count(&ft->s->windows)));
+}
+
+/* Callback for session_width. */
+char *
+format_cb_session_width(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->s->sx));
+}
+
+/* Callback for session_height. */
+char *
+format_cb_session_height(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->s->sy));
+}
+
+/* Callback for session_id. */
+char *
+format_cb_session_id(struct format_tree *ft)
+{
+	return (format_printf("$%u", ft->s->id));
+}
+
+/* Callback for session_grouped. */
+char *
+format_cb_session_grouped(struct format_tree *ft)
+{
+	return (format_printf("%d", session_group_find(ft->s) != NULL));
+}
+
+/* Callback for session_group. */
+char *
+format_cb_session_group(struct format_tree *ft)
+{
+	struct session_group	*sg;
 
-	if (window_pane_index(wp, &idx) != 0)
+	if ((sg = session_group_find(ft->s)) == NULL)
+		return (NULL);
+	return (format_printf("%u", session_group_index(sg)));
+}
+
+/* Callback for session_created. */
+char *
+format_cb_session_created(struct format_tree *ft)
+{
+	return (format_printf("%lld", (long long) ft->s->creation_time.tv_sec));
+}
+
+/* Callback for session_created_string. */
+char *
+format_cb_session_created_string(struct format_tree *ft)
+{
+	return (format_time(ft->s->creation_time.tv_sec));
+}
+
+/* Callback for session_attached. */
+char *
+format_cb_session_attached(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->s->attached));
+}
+
+/* Callback for session_many_attached. */
+char *
+format_cb_session_many_attached(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->s->attached > 1));
+}
+
+/* Callback for window_id. */
+char *
+format_cb_window_id(struct format_tree *ft)
+{
+	return (format_printf("@%u", ft->w->id));
+}
+
+/* Callback for window_name. */
+char *
+format_cb_window_name(struct format_tree *ft)
+{
+	return (xstrdup(ft->w->name));
+}
+
+/* Callback for window_width. */
+char *
+format_cb_window_width(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->w->sx));
+}
+
+/* Callback for window_height. */
+char *
+format_cb_window_height(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->w->sy));
+}
+
+/* Callback for window_layout. */
+char *
+format_cb_window_layout(struct format_tree *ft)
+{
+	return (layout_dump(ft->w));
+}
+
+/* Callback for window_panes. */
+char *
+format_cb_window_panes(struct format_tree *ft)
+{
+	return (format_printf("%u", window_count_panes(ft->w)));
+}
+
+/* Callback for window_zoomed_flag. */
+char *
+format_cb_window_zoomed_flag(struct format_tree *ft)
+{
+	return (format_printf("%u", !!(ft->w->flags & WINDOW_ZOOMED)));
+}
+
+/* Callback for window_index. */
+char *
+format_cb_window_index(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wl->idx));
+}
+
+/* Callback for window_flags. */
+char *
+format_cb_window_flags(struct format_tree *ft)
+{
+	return (window_printable_flags(ft->s, ft->wl));
+}
+
+/* Callback for window_active. */
+char *
+format_cb_window_active(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wl == ft->s->curw));
+}
+
+/* Callback for window_bell_flag. */
+char *
+format_cb_window_bell_flag(struct format_tree *ft)
+{
+	return (format_printf("%u", !!(ft->wl->flags & WINLINK_BELL)));
+}
+
+/* Callback for window_activity_flag. */
+char *
+format_cb_window_activity_flag(struct format_tree *ft)
+{
+	return (format_printf("%u", !!(ft->wl->flags & WINLINK_ACTIVITY)));
+}
+
+/* Callback for window_silence_flag. */
+char *
+format_cb_window_silence_flag(struct format_tree *ft)
+{
+	return (format_printf("%u", !!(ft->wl->flags & WINLINK_SILENCE)));
+}
+
+/* Callback for window_last_flag. */
+char *
+format_cb_window_last_flag(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->wl == TAILQ_FIRST(&ft->s->lastw)));
+}
+
+/* Callback for history_size. */
+char *
+format_cb_history_size(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->wp->base.grid->hsize));
+}
+
+/* Callback for history_limit. */
+char *
+format_cb_history_limit(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->wp->base.grid->hlimit));
+}
+
+/* Callback for history_bytes. */
+char *
+format_cb_history_bytes(struct format_tree *ft)
+{
+	return (format_printf("%llu", grid_history_bytes(ft->wp->base.grid)));
+}
+
+/* Callback for history_cold_size. */
+char *
+format_cb_history_cold_size(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->wp->base.grid->coldsize));
+}
+
+/* Callback for history_cold_bytes. */
+char *
+format_cb_history_cold_bytes(struct format_tree *ft)
+{
+	return (format_printf("%zu", ft->wp->base.grid->coldbytes));
+}
+
+/* Callback for history_spill_bytes. */
+char *
+format_cb_history_spill_bytes(struct format_tree *ft)
+{
+	return (format_printf("%zu", ft->wp->base.grid->spilllive));
+}
+
+/* Callback for pane_index. */
+char *
+format_cb_pane_index(struct format_tree *ft)
+{
+	u_int	idx;
+
+	if (window_pane_index(ft->wp, &idx) != 0)
 		fatalx("index not found");
-	format_add(ft, "pane_index", "%u", idx);
-
-	format_add(ft, "pane_width", "%u", wp->sx);
-	format_add(ft, "pane_height", "%u", wp->sy);
-	format_add(ft, "pane_title", "%s", wp->base.title);
-	format_add(ft, "pane_id", "%%%u", wp->id);
-	format_add(ft, "pane_active", "%d", wp == wp->window->active);
-	format_add(ft, "pane_input_off", "%d", !!(wp->flags & PANE_INPUTOFF));
-
-	status = wp->status;
-	if (wp->fd == -1 && WIFEXITED(status))
-		format_add(ft, "pane_dead_status", "%d", WEXITSTATUS(status));
-	format_add(ft, "pane_dead", "%d", wp->fd == -1);
-
-	if (window_pane_visible(wp)) {
-		format_add(ft, "pane_left", "%u", wp->xoff);
-		format_add(ft, "pane_top", "%u", wp->yoff);
-		format_add(ft, "pane_right", "%u", wp->xoff + wp->sx - 1);
-		format_add(ft, "pane_bottom", "%u", wp->yoff + wp->sy - 1);
-	}
+	return (format_printf("%u", idx));
+}
 
-	format_add(ft, "pane_in_mode", "%d", wp->screen != &wp->base);
-	format_add(ft, "pane_synchronized", "%d",
-	    !!options_get_number(&wp->window->options, "synchronize-panes"));
-
-	if (wp->tty != NULL)
-		format_add(ft, "pane_tty", "%s", wp->tty);
-	format_add(ft, "pane_pid", "%ld", (long) wp->pid);
-	if ((cwd = osdep_get_cwd(wp->fd)) != NULL)
-		format_add(ft, "pane_current_path", "%s", cwd);
-	if ((cmd = cmd_stringify_argv(wp->argc, wp->argv)) != NULL) {
-		format_add(ft, "pane_start_command", "%s", cmd);
-		free(cmd);
-	}
-	if ((cmd = format_get_command(wp)) != NULL) {
-		format_add(ft, "pane_current_command", "%s", cmd);
-		free(cmd);
-	}
+/* Callback for pane_width. */
+char *
+format_cb_pane_width(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->wp->sx));
+}
+
+/* Callback for pane_height. */
+char *
+format_cb_pane_height(struct format_tree *ft)
+{
+	return (format_printf("%u", ft->wp->sy));
+}
+
+/* Callback for pane_title. */
+char *
+format_cb_pane_title(struct format_tree *ft)
+{
+	return (xstrdup(ft->wp->base.title));
+}
+
+/* Callback for pane_id. */
+char *
+format_cb_pane_id(struct format_tree *ft)
+{
+	return (format_printf("%%%u", ft->wp->id));
+}
+
+/* Callback for pane_active. */
+char *
+format_cb_pane_active(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp == ft->wp->window->active));
+}
+
+/* Callback for pane_input_off. */
+char *
+format_cb_pane_input_off(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->flags & PANE_INPUTOFF)));
+}
+
+/* Callback for pane_dead_status. */
+char *
+format_cb_pane_dead_status(struct format_tree *ft)
+{
+	struct window_pane	*wp = ft->wp;
+
+	if (wp->fd != -1 || !WIFEXITED(wp->status))
+		return (NULL);
+	return (format_printf("%d", WEXITSTATUS(wp->status)));
+}
+
+/* Callback for pane_dead. */
+char *
+format_cb_pane_dead(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->fd == -1));
+}
+
+/* Callback for pane_left. */
+char *
+format_cb_pane_left(struct format_tree *ft)
+{
+	if (!window_pane_visible(ft->wp))
+		return (NULL);
+	return (format_printf("%u", ft->wp->xoff));
+}
+
+/* Callback for pane_top. */
+char *
+format_cb_pane_top(struct format_tree *ft)
+{
+	if (!window_pane_visible(ft->wp))
+		return (NULL);
+	return (format_printf("%u", ft->wp->yoff));
+}
+
+/* Callback for pane_right. */
+char *
+format_cb_pane_right(struct format_tree *ft)
+{
+	if (!window_pane_visible(ft->wp))
+		return (NULL);
+	return (format_printf("%u", ft->wp->xoff + ft->wp->sx - 1));
+}
+
+/* Callback for pane_bottom. */
+char *
+format_cb_pane_bottom(struct format_tree *ft)
+{
+	if (!window_pane_visible(ft->wp))
+		return (NULL);
+	return (format_printf("%u", ft->wp->yoff + ft->wp->sy - 1));
+}
+
+/* Callback for pane_in_mode. */
+char *
+format_cb_pane_in_mode(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->screen != &ft->wp->base));
+}
+
+/* Callback for pane_synchronized. */
+char *
+format_cb_pane_synchronized(struct format_tree *ft)
+{
+	struct window	*w = ft->wp->window;
+
+	return (format_printf("%d",
+	    !!options_get_number(&w->options, "synchronize-panes")));
+}
+
+/* Callback for pane_tty. */
+char *
+format_cb_pane_tty(struct format_tree *ft)
+{
+	return (xstrdup(ft->wp->tty));
+}
+
+/* Callback for pane_pid. */
+char *
+format_cb_pane_pid(struct format_tree *ft)
+{
+	return (format_printf("%ld", (long) ft->wp->pid));
+}
+
+/* Callback for pane_current_path. */
+char *
+format_cb_pane_current_path(struct format_tree *ft)
+{
+	char	*cwd;
+
+	if ((cwd = osdep_get_cwd(ft->wp->fd)) == NULL)
+		return (NULL);
+	return (xstrdup(cwd));
+}
+
+/* Callback for pane_start_command. */
+char *
+format_cb_pane_start_command(struct format_tree *ft)
+{
+	return (cmd_stringify_argv(ft->wp->argc, ft->wp->argv));
+}
+
+/* Callback for pane_current_command. */
+char *
+format_cb_pane_current_command(struct format_tree *ft)
+{
+	return (format_get_command(ft->wp));
+}
+
+/* Callback for cursor_x. */
+char *
+format_cb_cursor_x(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->base.cx));
+}
+
+/* Callback for cursor_y. */
+char *
+format_cb_cursor_y(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->base.cy));
+}
+
+/* Callback for scroll_region_upper. */
+char *
+format_cb_scroll_region_upper(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->base.rupper));
+}
+
+/* Callback for scroll_region_lower. */
+char *
+format_cb_scroll_region_lower(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->base.rlower));
+}
+
+/* Callback for saved_cursor_x. */
+char *
+format_cb_saved_cursor_x(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->ictx.old_cx));
+}
+
+/* Callback for saved_cursor_y. */
+char *
+format_cb_saved_cursor_y(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->ictx.old_cy));
+}
+
+/* Callback for alternate_on. */
+char *
+format_cb_alternate_on(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->saved_grid != NULL));
+}
+
+/* Callback for alternate_saved_x. */
+char *
+format_cb_alternate_saved_x(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->saved_cx));
+}
+
+/* Callback for alternate_saved_y. */
+char *
+format_cb_alternate_saved_y(struct format_tree *ft)
+{
+	return (format_printf("%d", ft->wp->saved_cy));
+}
+
+/* Callback for cursor_flag. */
+char *
+format_cb_cursor_flag(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->base.mode & MODE_CURSOR)));
+}
+
+/* Callback for insert_flag. */
+char *
+format_cb_insert_flag(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->base.mode & MODE_INSERT)));
+}
+
+/* Callback for keypad_cursor_flag. */
+char *
+format_cb_keypad_cursor_flag(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->base.mode & MODE_KCURSOR)));
+}
+
+/* Callback for keypad_flag. */
+char *
+format_cb_keypad_flag(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->base.mode & MODE_KKEYPAD)));
+}
+
+/* Callback for wrap_flag. */
+char *
+format_cb_wrap_flag(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->base.mode & MODE_WRAP)));
+}
+
+/* Callback for mouse_standard_flag. */
+char *
+format_cb_mouse_standard_flag(struct format_tree *ft)
+{
+	return (format_printf("%d",
+	    !!(ft->wp->base.mode & MODE_MOUSE_STANDARD)));
+}
+
+/* Callback for mouse_button_flag. */
+char *
+format_cb_mouse_button_flag(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->base.mode & MODE_MOUSE_BUTTON)));
+}
+
+/* Callback for mouse_utf8_flag. */
+char *
+format_cb_mouse_utf8_flag(struct format_tree *ft)
+{
+	return (format_printf("%d", !!(ft->wp->base.mode & MODE_MOUSE_UTF8)));
+}
+
+/* Callback for pane_tabs. */
+char *
+format_cb_pane_tabs(struct format_tree *ft)
+{
+	return (format_pane_tabs(ft->wp));
+}
+
+/* Set defaults for any of arguments that are not NULL. */
+void
+format_defaults(struct format_tree *ft, struct client *c, struct session *s,
+    struct winlink *wl, struct window_pane *wp)
+{
+	if (s == NULL && c != NULL)
+		s = c->session;
+	if (wl == NULL && s != NULL)
+		wl = s->curw;
+	if (wp == NULL && wl != NULL)
+		wp = wl->window->active;
+
+	if (c != NULL)
+		format_defaults_client(ft, c);
+	if (s != NULL)
+		format_defaults_session(ft, s);
+	if (s != NULL && wl != NULL)
+		format_defaults_winlink(ft, s, wl);
+	if (wp != NULL)
+		format_defaults_pane(ft, wp);
+}
+
+/* Set default format keys for a session. */
+void
+format_defaults_session(struct format_tree *ft, struct session *s)
+{
+	ft->s = s;
+	ft->flags |= FORMAT_SESSION;
+}
+
+/* Set default format keys for a client. */
+void
+format_defaults_client(struct format_tree *ft, struct client *c)
+{
+	if (ft->s == NULL)
+		ft->s = c->session;
+
+	ft->c = c;
+	ft->flags |= FORMAT_CLIENT;
+}
+
+/* Set default format keys for a window. */
+void
+format_defaults_window(struct format_tree *ft, struct window *w)
+{
+	ft->w = w;
+	ft->flags |= FORMAT_WINDOW;
+}
+
+/* Set default format keys for a winlink. */
+void
+format_defaults_winlink(struct format_tree *ft, struct session *s,
+    struct winlink *wl)
+{
+	if (ft->w == NULL)
+		ft->w = wl->window;
+
+	format_defaults_window(ft, wl->window);
+
+	ft->s = s;
+	ft->wl = wl;
+	ft->flags |= FORMAT_WINLINK;
+}
+
+/* Set default format keys for a window pane. */
+void
+format_defaults_pane(struct format_tree *ft, struct window_pane *wp)
+{
+	if (ft->w == NULL)
+		ft->w = wp->window;
 
-	format_add(ft, "cursor_x", "%d", wp->base.cx);
-	format_add(ft, "cursor_y", "%d", wp->base.cy);
-	format_add(ft, "scroll_region_upper", "%d", wp->base.rupper);
-	format_add(ft, "scroll_region_lower", "%d", wp->base.rlower);
-	format_add(ft, "saved_cursor_x", "%d", wp->ictx.old_cx);
-	format_add(ft, "saved_cursor_y", "%d", wp->ictx.old_cy);
-
-	format_add(ft, "alternate_on", "%d", wp->saved_grid ? 1 : 0);
-	format_add(ft, "alternate_saved_x", "%d", wp->saved_cx);
-	format_add(ft, "alternate_saved_y", "%d", wp->saved_cy);
-
-	format_add(ft, "cursor_flag", "%d",
-	    !!(wp->base.mode & MODE_CURSOR));
-	format_add(ft, "insert_flag", "%d",
-	    !!(wp->base.mode & MODE_INSERT));
-	format_add(ft, "keypad_cursor_flag", "%d",
-	    !!(wp->base.mode & MODE_KCURSOR));
-	format_add(ft, "keypad_flag", "%d",
-	    !!(wp->base.mode & MODE_KKEYPAD));
-	format_add(ft, "wrap_flag", "%d",
-	    !!(wp->base.mode & MODE_WRAP));
-
-	format_add(ft, "mouse_standard_flag", "%d",
-	    !!(wp->base.mode & MODE_MOUSE_STANDARD));
-	format_add(ft, "mouse_button_flag", "%d",
-	    !!(wp->base.mode & MODE_MOUSE_BUTTON));
-	format_add(ft, "mouse_utf8_flag", "%d",
-	    !!(wp->base.mode & MODE_MOUSE_UTF8));
-
-	format_defaults_pane_tabs(ft, wp);
+	ft->wp = wp;
+	ft->flags |= FORMAT_PANE;
 }
 
 /* Set default format keys for paste buffer. */
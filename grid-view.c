@@ -52,17 +52,26 @@ grid_view_set_cell(
 	grid_set_cell(gd, grid_view_x(gd, px), grid_view_y(gd, py), gc);
 }
 
+/* Set cells from a string of ASCII characters. */
+void
+grid_view_set_cells(struct grid *gd, u_int px, u_int py,
+    const struct grid_cell *gc, const u_char *s, size_t slen)
+{
+	grid_set_cells(gd, grid_view_x(gd, px), grid_view_y(gd, py), gc, s,
+	    slen);
+}
+
 /* Clear into history. */
 void
 grid_view_clear_history(struct grid *gd)
 {
-	struct grid_line	*gl;
+	const struct grid_line	*gl;
 	u_int			 yy, last;
 
 	/* Find the last used line. */
 	last = 0;
 	for (yy = 0; yy < gd->sy; yy++) {
-		gl = &gd->linedata[grid_view_y(gd, yy)];
+		gl = grid_peek_line(gd, grid_view_y(gd, yy));
 		if (gl->cellsize != 0)
 			last = yy + 1;
 	}
@@ -71,8 +80,8 @@ grid_view_clear_history(struct grid *gd)
 
 	/* Scroll the lines into the history. */
 	for (yy = 0; yy < last; yy++) {
-		grid_collect_history(gd);
 		grid_scroll_history(gd);
+		grid_collect_history(gd);
 	}
 }
 
@@ -91,7 +100,6 @@ void
 grid_view_scroll_region_up(struct grid *gd, u_int rupper, u_int rlower)
 {
 	if (gd->flags & GRID_HISTORY) {
-		grid_collect_history(gd);
 		if (rupper == 0 && rlower == gd->sy - 1)
 			grid_scroll_history(gd);
 		else {
@@ -99,6 +107,7 @@ grid_view_scroll_region_up(struct grid *gd, u_int rupper, u_int rlower)
 			rlower = grid_view_y(gd, rlower);
 			grid_scroll_history_region(gd, rupper, rlower);
 		}
+		grid_collect_history(gd);
 	} else {
 		rupper = grid_view_y(gd, rupper);
 		rlower = grid_view_y(gd, rlower);
@@ -17,9 +17,12 @@
  */
 
 #include <sys/types.h>
+#include <sys/mman.h>
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
@@ -33,14 +36,27 @@
  * (hsize - 1); from hsize to hsize + (sy - 1) is the viewable data. All
  * functions in this file work on absolute coordinates, grid-view.c has
  * functions which work on the screen data.
+ *
+ * The lines are kept in a circular buffer: linedata holds linesize lines and
+ * line zero is at lineoffset. This means scrolling into a full history just
+ * frees the oldest line and moves the offset, without moving or reallocating
+ * the other lines. grid_get_line converts from absolute coordinates.
+ *
+ * Lines which are scrolled into the history are compacted: each cell is
+ * stored as a five byte struct grid_cell_entry and only cells which do not
+ * fit (UTF-8 or wide characters) are kept in full, in a per-line array of
+ * extended cells. A compact line is expanded again if it is written to.
+ *
+ * Older history lines may be frozen: compressed in blocks, which may in turn
+ * be written to a spill file and mapped back in when they are needed.
  */
 
 /* Default grid cell data. */
 const struct grid_cell grid_default_cell = { 0, 0, 8, 8, (1 << 4) | 1, " " };
 
 #define grid_put_cell(gd, px, py, gc) do {			\
-	memcpy(&gd->linedata[py].celldata[px], 			\
-	    gc, sizeof gd->linedata[py].celldata[px]);		\
+	memcpy(&grid_get_line(gd, py)->celldata[px],		\
+	    gc, sizeof (struct grid_cell));			\
 } while (0)
 #define grid_put_utf8(gd, px, py, gc) do {			\
 	memcpy(&gd->linedata[py].utf8data[px], 			\
@@ -69,10 +85,31 @@ grid_check_y(struct grid *gd, u_int py)
 }
 #endif
 
+void	grid_drop_line(struct grid *);
+int	grid_cell_is_simple(const struct grid_cell *);
+void	grid_compact_line(struct grid_line *);
+void	grid_uncompact_line(struct grid *, struct grid_line *);
+void	grid_free_line(struct grid *, struct grid_line *);
+void	grid_decode_entry(struct grid_cell *, const struct grid_cell_entry *,
+	    const struct grid_cell *);
+const struct grid_cell *grid_decode_line(struct grid *,
+	    const struct grid_line *);
+size_t	grid_rle_encode(const u_char *, size_t, u_char *);
+void	grid_rle_decode(const u_char *, size_t, u_char *, size_t);
+const u_char *grid_thaw_block(struct grid *, struct grid_block *);
+void	grid_release_block(struct grid *, struct grid_block *);
+void	grid_freeze_lines(struct grid *, u_int, u_int);
+const u_char *grid_block_data(struct grid *, struct grid_block *);
+void	grid_spill_block(struct grid *, struct grid_block *);
+void	grid_spill_unmap(struct grid *);
+void	grid_spill_compact(struct grid *);
+void	grid_spill_stop(struct grid *);
 void	grid_reflow_join(struct grid *, u_int *, struct grid_line *, u_int);
 void	grid_reflow_split(struct grid *, u_int *, struct grid_line *, u_int,
 	    u_int);
 void	grid_reflow_move(struct grid *, u_int *, struct grid_line *);
+u_int	grid_reflow_start(struct grid *, u_int, u_int);
+u_int	grid_reflow_lines(struct grid *, u_int, u_int, u_int, u_int);
 size_t	grid_string_cells_fg(const struct grid_cell *, int *);
 size_t	grid_string_cells_bg(const struct grid_cell *, int *);
 void	grid_string_cells_code(const struct grid_cell *,
@@ -94,6 +131,30 @@ grid_create(u_int sx, u_int sy, u_int hlimit)
 	gd->hlimit = hlimit;
 
 	gd->linedata = xcalloc(gd->sy, sizeof *gd->linedata);
+	gd->linesize = gd->sy;
+	gd->lineoffset = 0;
+
+	gd->hreflow = 0;
+
+	gd->decodedline = NULL;
+	gd->decodeddata = NULL;
+	gd->decodedsize = 0;
+
+	gd->hfrozen = 0;
+	gd->coldsize = 0;
+	gd->coldbytes = 0;
+
+	gd->thawedblock = NULL;
+	gd->thaweddata = NULL;
+	gd->thawedsize = 0;
+
+	gd->spillfd = -1;
+	gd->hspilled = 0;
+	gd->spillsize = 0;
+	gd->spilllive = 0;
+	gd->spillmap = NULL;
+	gd->spillmapsize = 0;
+	TAILQ_INIT(&gd->spilled);
 
 	return (gd);
 }
@@ -105,12 +166,21 @@ grid_destroy(struct grid *gd)
 	struct grid_line	*gl;
 	u_int			 yy;
 
+	/* Close the spill file first so freeing the blocks does not touch it. */
+	if (gd->spillfd != -1) {
+		grid_spill_unmap(gd);
+		close(gd->spillfd);
+		gd->spillfd = -1;
+	}
+
 	for (yy = 0; yy < gd->hsize + gd->sy; yy++) {
-		gl = &gd->linedata[yy];
-		free(gl->celldata);
+		gl = grid_get_line(gd, yy);
+		grid_free_line(gd, gl);
 	}
 
 	free(gd->linedata);
+	free(gd->decodeddata);
+	free(gd->thaweddata);
 
 	free(gd);
 }
@@ -127,8 +197,8 @@ grid_compare(struct grid *ga, struct grid *gb)
 		return (1);
 
 	for (yy = 0; yy < ga->sy; yy++) {
-		gla = &ga->linedata[yy];
-		glb = &gb->linedata[yy];
+		gla = grid_get_line(ga, yy);
+		glb = grid_get_line(gb, yy);
 		if (gla->cellsize != glb->cellsize)
 			return (1);
 		for (xx = 0; xx < ga->sx; xx++) {
@@ -142,29 +212,106 @@ grid_compare(struct grid *ga, struct grid *gb)
 	return (0);
 }
 
+/* Get line at absolute position. */
+struct grid_line *
+grid_get_line(struct grid *gd, u_int py)
+{
+	u_int	yy;
+
+	yy = gd->lineoffset + py;
+	if (yy >= gd->linesize)
+		yy -= gd->linesize;
+	return (&gd->linedata[yy]);
+}
+
 /*
- * Collect lines from the history if at the limit. Free the top (oldest) 10%
- * and shift up.
+ * Make sure there is space for at least ny lines. Lines not in use are always
+ * zeroed.
  */
 void
-grid_collect_history(struct grid *gd)
+grid_reserve_lines(struct grid *gd, u_int ny)
 {
-	u_int	yy;
+	struct grid_line	*linedata;
+	u_int			 size, first;
 
-	if (gd->hsize < gd->hlimit)
+	if (ny <= gd->linesize)
 		return;
 
-	yy = gd->hlimit / 10;
-	if (yy < 1)
-		yy = 1;
+	/*
+	 * Grow by doubling but not beyond what the history limit needs, so a
+	 * full history fits exactly.
+	 */
+	size = gd->linesize * 2;
+	if (gd->hlimit < UINT_MAX - gd->sy && size > gd->hlimit + gd->sy + 1)
+		size = gd->hlimit + gd->sy + 1;
+	if (size < ny)
+		size = ny;
+
+	if (gd->lineoffset == 0) {
+		gd->linedata = xreallocarray(gd->linedata, size,
+		    sizeof *gd->linedata);
+		memset(&gd->linedata[gd->linesize], 0,
+		    (size - gd->linesize) * sizeof *gd->linedata);
+	} else {
+		linedata = xcalloc(size, sizeof *linedata);
+		first = gd->linesize - gd->lineoffset;
+		memcpy(linedata, &gd->linedata[gd->lineoffset],
+		    first * sizeof *linedata);
+		memcpy(linedata + first, gd->linedata,
+		    gd->lineoffset * sizeof *linedata);
+		free(gd->linedata);
+		gd->linedata = linedata;
+		gd->lineoffset = 0;
+	}
+	gd->linesize = size;
+}
+
+/* Free the oldest line in the history and move the start of the buffer. */
+void
+grid_drop_line(struct grid *gd)
+{
+	struct grid_line	*gl;
+
+	gl = grid_get_line(gd, 0);
+	grid_free_line(gd, gl);
+	memset(gl, 0, sizeof *gl);
+
+	gd->lineoffset++;
+	if (gd->lineoffset == gd->linesize)
+		gd->lineoffset = 0;
+	gd->hsize--;
+	if (gd->hreflow > 0)
+		gd->hreflow--;
+	if (gd->hfrozen > 0)
+		gd->hfrozen--;
+	if (gd->hspilled > 0)
+		gd->hspilled--;
+}
 
-	grid_move_lines(gd, 0, yy, gd->hsize + gd->sy - yy);
-	gd->hsize -= yy;
+/* Collect lines from the history if over the limit, oldest first. */
+void
+grid_collect_history(struct grid *gd)
+{
+	while (gd->hsize > gd->hlimit)
+		grid_drop_line(gd);
+}
+
+/* Free the entire history. */
+void
+grid_clear_history(struct grid *gd)
+{
+	grid_clear_lines(gd, 0, gd->hsize);
+	grid_move_lines(gd, 0, gd->hsize, gd->sy);
+
+	gd->hsize = 0;
+	gd->hreflow = 0;
+	gd->hfrozen = 0;
+	gd->hspilled = 0;
 }
 
 /*
  * Scroll the entire visible screen, moving one line into the history. Just
- * allocate a new line at the bottom and move the history size indicator.
+ * add a new line at the bottom and move the history size indicator.
  */
 void
 grid_scroll_history(struct grid *gd)
@@ -172,44 +319,651 @@ grid_scroll_history(struct grid *gd)
 	u_int	yy;
 
 	yy = gd->hsize + gd->sy;
-	gd->linedata = xreallocarray(gd->linedata, yy + 1,
-	    sizeof *gd->linedata);
-	memset(&gd->linedata[yy], 0, sizeof gd->linedata[yy]);
+	grid_reserve_lines(gd, yy + 1);
+	memset(grid_get_line(gd, yy), 0, sizeof *gd->linedata);
 
 	gd->hsize++;
+	grid_compact_line(grid_get_line(gd, gd->hsize - 1));
 }
 
 /* Scroll a region up, moving the top line into the history. */
 void
 grid_scroll_history_region(struct grid *gd, u_int upper, u_int lower)
 {
-	struct grid_line	*gl_history, *gl_upper, *gl_lower;
+	struct grid_line	*gl_history;
 	u_int			 yy;
 
 	/* Create a space for a new line. */
 	yy = gd->hsize + gd->sy;
-	gd->linedata = xreallocarray(gd->linedata, yy + 1,
-	    sizeof *gd->linedata);
+	grid_reserve_lines(gd, yy + 1);
 
 	/* Move the entire screen down to free a space for this line. */
-	gl_history = &gd->linedata[gd->hsize];
-	memmove(gl_history + 1, gl_history, gd->sy * sizeof *gl_history);
+	for (; yy > gd->hsize; yy--) {
+		memcpy(grid_get_line(gd, yy), grid_get_line(gd, yy - 1),
+		    sizeof *gd->linedata);
+	}
 
-	/* Adjust the region and find its start and end. */
+	/* Adjust the region. */
 	upper++;
-	gl_upper = &gd->linedata[upper];
 	lower++;
-	gl_lower = &gd->linedata[lower];
 
 	/* Move the line into the history. */
-	memcpy(gl_history, gl_upper, sizeof *gl_history);
+	gl_history = grid_get_line(gd, gd->hsize);
+	memcpy(gl_history, grid_get_line(gd, upper), sizeof *gl_history);
 
 	/* Then move the region up and clear the bottom line. */
-	memmove(gl_upper, gl_upper + 1, (lower - upper) * sizeof *gl_upper);
-	memset(gl_lower, 0, sizeof *gl_lower);
+	for (yy = upper; yy < lower; yy++) {
+		memcpy(grid_get_line(gd, yy), grid_get_line(gd, yy + 1),
+		    sizeof *gd->linedata);
+	}
+	memset(grid_get_line(gd, lower), 0, sizeof *gd->linedata);
 
 	/* Move the history offset down over the line. */
 	gd->hsize++;
+	grid_compact_line(gl_history);
+}
+
+/* Can this cell be stored inline in a compact entry? */
+int
+grid_cell_is_simple(const struct grid_cell *gc)
+{
+	return (gc->xstate == ((1 << 4) | 1));
+}
+
+/* Convert a line to compact form. */
+void
+grid_compact_line(struct grid_line *gl)
+{
+	struct grid_cell_entry	*gce;
+	const struct grid_cell	*gc;
+	u_int			 xx, extdsize;
+
+	if (gl->flags & (GRID_LINE_COMPACT|GRID_LINE_COLD))
+		return;
+	if (gl->cellsize == 0) {
+		free(gl->celldata);
+		gl->celldata = NULL;
+		return;
+	}
+
+	extdsize = 0;
+	for (xx = 0; xx < gl->cellsize; xx++) {
+		if (!grid_cell_is_simple(&gl->celldata[xx]))
+			extdsize++;
+	}
+
+	gl->compactdata = xreallocarray(NULL, gl->cellsize,
+	    sizeof *gl->compactdata);
+	if (extdsize != 0) {
+		gl->extddata = xreallocarray(NULL, extdsize,
+		    sizeof *gl->extddata);
+	}
+	gl->extdsize = 0;
+
+	for (xx = 0; xx < gl->cellsize; xx++) {
+		gc = &gl->celldata[xx];
+		gce = &gl->compactdata[xx];
+		if (grid_cell_is_simple(gc)) {
+			gce->flags = gc->flags;
+			gce->data.attr = gc->attr;
+			gce->data.fg = gc->fg;
+			gce->data.bg = gc->bg;
+			gce->data.data = gc->xdata[0];
+		} else {
+			gce->flags = GRID_FLAG_EXTENDED;
+			gce->offset = gl->extdsize;
+			memcpy(&gl->extddata[gl->extdsize++], gc, sizeof *gc);
+		}
+	}
+
+	free(gl->celldata);
+	gl->celldata = NULL;
+	gl->flags |= GRID_LINE_COMPACT;
+}
+
+/* Convert a compact or cold line back to full cells. */
+void
+grid_uncompact_line(struct grid *gd, struct grid_line *gl)
+{
+	const struct grid_cell	*decoded;
+
+	if (!(gl->flags & (GRID_LINE_COMPACT|GRID_LINE_COLD)))
+		return;
+
+	decoded = grid_decode_line(gd, gl);
+	gl->celldata = xreallocarray(NULL, gl->cellsize, sizeof *gl->celldata);
+	memcpy(gl->celldata, decoded, gl->cellsize * sizeof *gl->celldata);
+	gd->decodedline = NULL;
+
+	if (gl->flags & GRID_LINE_COLD) {
+		grid_release_block(gd, gl->block);
+		gl->block = NULL;
+		gd->coldsize--;
+	}
+	free(gl->compactdata);
+	gl->compactdata = NULL;
+	free(gl->extddata);
+	gl->extddata = NULL;
+	gl->extdsize = 0;
+
+	gl->flags &= ~(GRID_LINE_COMPACT|GRID_LINE_COLD);
+}
+
+/* Expand a set of compact lines back to full cells. */
+void
+grid_uncompact_lines(struct grid *gd, u_int py, u_int ny)
+{
+	u_int	yy;
+
+	for (yy = py; yy < py + ny; yy++) {
+		if (grid_check_y(gd, yy) != 0)
+			return;
+		grid_uncompact_line(gd, grid_get_line(gd, yy));
+	}
+}
+
+/* Free the cells of a line. */
+void
+grid_free_line(struct grid *gd, struct grid_line *gl)
+{
+	if (gl->compactdata != NULL && gd->decodedline == gl->compactdata)
+		gd->decodedline = NULL;
+	if (gl->flags & GRID_LINE_COLD) {
+		grid_release_block(gd, gl->block);
+		gd->coldsize--;
+	}
+	free(gl->compactdata);
+	free(gl->extddata);
+	free(gl->celldata);
+}
+
+/* Convert a compact entry into a full cell. */
+void
+grid_decode_entry(struct grid_cell *gc, const struct grid_cell_entry *gce,
+    const struct grid_cell *extddata)
+{
+	if (gce->flags & GRID_FLAG_EXTENDED) {
+		memcpy(gc, &extddata[gce->offset], sizeof *gc);
+		return;
+	}
+	memcpy(gc, &grid_default_cell, sizeof *gc);
+	gc->flags = gce->flags;
+	gc->attr = gce->data.attr;
+	gc->fg = gce->data.fg;
+	gc->bg = gce->data.bg;
+	grid_cell_one(gc, gce->data.data);
+}
+
+/*
+ * Decode a compact or cold line into full cells. The result is valid until
+ * another line in the same grid is decoded or the line is changed.
+ */
+const struct grid_cell *
+grid_decode_line(struct grid *gd, const struct grid_line *gl)
+{
+	struct grid_cell_entry	 gce;
+	const struct grid_cell	*extddata;
+	const u_char		*data, *plane;
+	u_char			*p;
+	u_int			 xx, i, cells;
+
+	if (gl->flags & GRID_LINE_COLD) {
+		data = grid_thaw_block(gd, gl->block);
+		if (gd->decodedline == data + gl->blockoffset)
+			return (gd->decodeddata);
+	} else {
+		data = NULL;
+		if (gd->decodedline == gl->compactdata)
+			return (gd->decodeddata);
+	}
+
+	if (gl->cellsize > gd->decodedsize) {
+		gd->decodeddata = xreallocarray(gd->decodeddata, gl->cellsize,
+		    sizeof *gd->decodeddata);
+		gd->decodedsize = gl->cellsize;
+	}
+
+	if (data == NULL) {
+		for (xx = 0; xx < gl->cellsize; xx++) {
+			grid_decode_entry(&gd->decodeddata[xx],
+			    &gl->compactdata[xx], gl->extddata);
+		}
+		gd->decodedline = gl->compactdata;
+		return (gd->decodeddata);
+	}
+
+	cells = gl->block->cells;
+	extddata = (const struct grid_cell *)(data + cells * sizeof gce);
+	p = (u_char *)&gce;
+	for (xx = 0; xx < gl->cellsize; xx++) {
+		plane = data + gl->blockoffset + xx;
+		for (i = 0; i < sizeof gce; i++)
+			p[i] = plane[i * cells];
+		grid_decode_entry(&gd->decodeddata[xx], &gce, extddata);
+	}
+	gd->decodedline = data + gl->blockoffset;
+	return (gd->decodeddata);
+}
+
+/*
+ * Run-length encode a buffer. A control byte below 128 is followed by that
+ * many plus one literal bytes; otherwise the next byte is repeated the low
+ * seven bits plus three times. The output must have space for len + len / 128
+ * + 1 bytes.
+ */
+size_t
+grid_rle_encode(const u_char *in, size_t len, u_char *out)
+{
+	size_t	i, o, run, start;
+
+	i = o = 0;
+	while (i < len) {
+		run = 1;
+		while (i + run < len && run < 130 && in[i + run] == in[i])
+			run++;
+		if (run >= 3) {
+			out[o++] = 0x80|(run - 3);
+			out[o++] = in[i];
+			i += run;
+			continue;
+		}
+
+		start = i;
+		while (i < len && i - start < 128) {
+			if (i + 2 < len && in[i] == in[i + 1] &&
+			    in[i] == in[i + 2])
+				break;
+			i++;
+		}
+		out[o++] = i - start - 1;
+		memcpy(out + o, in + start, i - start);
+		o += i - start;
+	}
+	return (o);
+}
+
+/* Decode a run-length encoded buffer of known size. */
+void
+grid_rle_decode(const u_char *in, size_t len, u_char *out, size_t outlen)
+{
+	size_t	i, o, n;
+
+	i = o = 0;
+	while (i < len) {
+		if (in[i] & 0x80) {
+			n = (in[i] & 0x7f) + 3;
+			if (i + 1 >= len || o + n > outlen)
+				fatalx("bad history block");
+			memset(out + o, in[i + 1], n);
+			i += 2;
+		} else {
+			n = in[i] + 1;
+			if (i + 1 + n > len || o + n > outlen)
+				fatalx("bad history block");
+			memcpy(out + o, in + i + 1, n);
+			i += 1 + n;
+		}
+		o += n;
+	}
+	if (o != outlen)
+		fatalx("bad history block");
+}
+
+/* Expand a block into the grid's buffer, if it is not already there. */
+const u_char *
+grid_thaw_block(struct grid *gd, struct grid_block *gb)
+{
+	size_t	size;
+
+	if (gd->thawedblock == gb)
+		return (gd->thaweddata);
+
+	size = gb->cells * sizeof (struct grid_cell_entry);
+	size += gb->extdsize * sizeof (struct grid_cell);
+	if (size > gd->thawedsize) {
+		gd->thaweddata = xrealloc(gd->thaweddata, size);
+		gd->thawedsize = size;
+	}
+	grid_rle_decode(grid_block_data(gd, gb), gb->size, gd->thaweddata,
+	    size);
+
+	gd->thawedblock = gb;
+	gd->decodedline = NULL;
+	return (gd->thaweddata);
+}
+
+/* Drop a reference to a block and free it if it is no longer used. */
+void
+grid_release_block(struct grid *gd, struct grid_block *gb)
+{
+	if (--gb->references != 0)
+		return;
+
+	if (gd->thawedblock == gb) {
+		gd->thawedblock = NULL;
+		gd->decodedline = NULL;
+	}
+
+	if (gb->data != NULL) {
+		gd->coldbytes -= gb->size + sizeof *gb;
+		free(gb->data);
+		free(gb);
+		return;
+	}
+	gd->coldbytes -= sizeof *gb;
+
+	TAILQ_REMOVE(&gd->spilled, gb, entry);
+	gd->spilllive -= gb->size;
+	free(gb);
+
+	/*
+	 * The file is only appended to, so reclaim the space when nothing is
+	 * left or when more than half of it is no longer used.
+	 */
+	if (gd->spillfd == -1)
+		return;
+	if (gd->spilllive == 0) {
+		grid_spill_unmap(gd);
+		if (ftruncate(gd->spillfd, 0) != 0)
+			log_debug("ftruncate failed: %s", strerror(errno));
+		gd->spillsize = 0;
+	} else if (gd->spillsize - gd->spilllive > gd->spilllive &&
+	    gd->spillsize > GRID_SPILL_SLACK)
+		grid_spill_compact(gd);
+}
+
+/* Get the compressed data for a block, from the spill file if needed. */
+const u_char *
+grid_block_data(struct grid *gd, struct grid_block *gb)
+{
+	void	*map;
+
+	if (gb->data != NULL)
+		return (gb->data);
+
+	if (gb->offset + gb->size > gd->spillmapsize) {
+		grid_spill_unmap(gd);
+		map = mmap(NULL, gd->spillsize, PROT_READ, MAP_SHARED,
+		    gd->spillfd, 0);
+		if (map == MAP_FAILED) {
+			log_debug("mmap failed: %s", strerror(errno));
+			grid_spill_stop(gd);
+			return (gb->data);
+		}
+		gd->spillmap = map;
+		gd->spillmapsize = gd->spillsize;
+	}
+	return (gd->spillmap + gb->offset);
+}
+
+/* Write a block to the end of the spill file and free its data. */
+void
+grid_spill_block(struct grid *gd, struct grid_block *gb)
+{
+	ssize_t	n;
+
+	n = pwrite(gd->spillfd, gb->data, gb->size, gd->spillsize);
+	if (n == -1 || (size_t)n != gb->size) {
+		log_debug("pwrite failed: %s", strerror(errno));
+		grid_spill_stop(gd);
+		return;
+	}
+
+	gb->offset = gd->spillsize;
+	gd->spillsize += gb->size;
+	gd->spilllive += gb->size;
+	TAILQ_INSERT_TAIL(&gd->spilled, gb, entry);
+
+	gd->coldbytes -= gb->size;
+	free(gb->data);
+	gb->data = NULL;
+}
+
+/* Remove the mapping of the spill file. */
+void
+grid_spill_unmap(struct grid *gd)
+{
+	if (gd->spillmap == NULL)
+		return;
+	munmap(gd->spillmap, gd->spillmapsize);
+	gd->spillmap = NULL;
+	gd->spillmapsize = 0;
+}
+
+/* Move the blocks still in use to the start of the spill file. */
+void
+grid_spill_compact(struct grid *gd)
+{
+	struct grid_block	*gb;
+	u_char			*buf;
+	size_t			 bufsize;
+	off_t			 offset;
+
+	grid_spill_unmap(gd);
+
+	buf = NULL;
+	bufsize = 0;
+	offset = 0;
+	TAILQ_FOREACH(gb, &gd->spilled, entry) {
+		if (gb->offset != offset) {
+			if (gb->size > bufsize) {
+				buf = xrealloc(buf, gb->size);
+				bufsize = gb->size;
+			}
+			if (pread(gd->spillfd, buf, gb->size, gb->offset) !=
+			    (ssize_t)gb->size ||
+			    pwrite(gd->spillfd, buf, gb->size, offset) !=
+			    (ssize_t)gb->size) {
+				log_debug("compact failed: %s", strerror(errno));
+				free(buf);
+				grid_spill_stop(gd);
+				return;
+			}
+			gb->offset = offset;
+		}
+		offset += gb->size;
+	}
+	free(buf);
+
+	if (ftruncate(gd->spillfd, offset) != 0)
+		log_debug("ftruncate failed: %s", strerror(errno));
+	gd->spillsize = offset;
+}
+
+/*
+ * Give up on the spill file after an error: read the spilled blocks back into
+ * memory, close it and do not open another. A block which cannot be read is
+ * replaced by blank cells rather than losing the whole server.
+ */
+void
+grid_spill_stop(struct grid *gd)
+{
+	struct grid_block	*gb;
+	struct grid_cell_entry	 gce;
+	u_char			*data, *p;
+	size_t			 size;
+	u_int			 i;
+
+	while ((gb = TAILQ_FIRST(&gd->spilled)) != NULL) {
+		TAILQ_REMOVE(&gd->spilled, gb, entry);
+
+		data = xmalloc(gb->size);
+		if (pread(gd->spillfd, data, gb->size, gb->offset) ==
+		    (ssize_t)gb->size)
+			gb->data = data;
+		else if (gb->offset + gb->size <= gd->spillmapsize) {
+			memcpy(data, gd->spillmap + gb->offset, gb->size);
+			gb->data = data;
+		} else {
+			log_debug("history block lost: %s", strerror(errno));
+			free(data);
+
+			memset(&gce, 0, sizeof gce);
+			gce.data.fg = 8;
+			gce.data.bg = 8;
+			gce.data.data = ' ';
+
+			size = gb->cells * sizeof gce;
+			size += gb->extdsize * sizeof (struct grid_cell);
+			data = xcalloc(1, size);
+			p = (u_char *)&gce;
+			for (i = 0; i < sizeof gce; i++)
+				memset(data + i * gb->cells, p[i], gb->cells);
+
+			gb->data = xmalloc(size + size / 128 + 1);
+			gb->size = grid_rle_encode(data, size, gb->data);
+			free(data);
+
+			if (gd->thawedblock == gb) {
+				gd->thawedblock = NULL;
+				gd->decodedline = NULL;
+			}
+		}
+		gd->coldbytes += gb->size;
+	}
+
+	grid_spill_unmap(gd);
+	close(gd->spillfd);
+	gd->spillfd = -1;
+	gd->flags |= GRID_NOSPILL;
+
+	gd->hspilled = 0;
+	gd->spillsize = 0;
+	gd->spilllive = 0;
+}
+
+/* Compress a set of compact history lines into a block. */
+void
+grid_freeze_lines(struct grid *gd, u_int py, u_int ny)
+{
+	struct grid_block	*gb;
+	struct grid_line	*gl;
+	struct grid_cell_entry	 gce;
+	u_char			*data, *p;
+	size_t			 size;
+	u_int			 yy, xx, i, n, e, lines;
+
+	gb = xcalloc(1, sizeof *gb);
+	for (yy = py; yy < py + ny; yy++) {
+		gl = grid_get_line(gd, yy);
+		if (gl->flags & GRID_LINE_COMPACT) {
+			gb->cells += gl->cellsize;
+			gb->extdsize += gl->extdsize;
+		}
+	}
+	if (gb->cells == 0) {
+		free(gb);
+		return;
+	}
+
+	size = gb->cells * sizeof gce + gb->extdsize * sizeof *gl->extddata;
+	data = xmalloc(size);
+
+	/*
+	 * Store each byte of the entries in its own plane, so that runs of the
+	 * same attributes and colours compress well. Extended cells are
+	 * renumbered from the start of the block.
+	 */
+	p = (u_char *)&gce;
+	n = e = lines = 0;
+	for (yy = py; yy < py + ny; yy++) {
+		gl = grid_get_line(gd, yy);
+		if (~gl->flags & GRID_LINE_COMPACT)
+			continue;
+
+		gl->blockoffset = n;
+		for (xx = 0; xx < gl->cellsize; xx++) {
+			memcpy(&gce, &gl->compactdata[xx], sizeof gce);
+			if (gce.flags & GRID_FLAG_EXTENDED)
+				gce.offset += e;
+			for (i = 0; i < sizeof gce; i++)
+				data[i * gb->cells + n] = p[i];
+			n++;
+		}
+		memcpy(data + gb->cells * sizeof gce + e * sizeof *gl->extddata,
+		    gl->extddata, gl->extdsize * sizeof *gl->extddata);
+		e += gl->extdsize;
+
+		if (gd->decodedline == gl->compactdata)
+			gd->decodedline = NULL;
+		free(gl->compactdata);
+		gl->compactdata = NULL;
+		free(gl->extddata);
+		gl->extddata = NULL;
+
+		gl->block = gb;
+		gl->flags &= ~GRID_LINE_COMPACT;
+		gl->flags |= GRID_LINE_COLD;
+		lines++;
+	}
+
+	gb->data = xmalloc(size + size / 128 + 1);
+	gb->size = grid_rle_encode(data, size, gb->data);
+	gb->data = xrealloc(gb->data, gb->size);
+	gb->references = lines;
+	free(data);
+
+	gd->coldsize += lines;
+	gd->coldbytes += gb->size + sizeof *gb;
+}
+
+/*
+ * Compress history lines older than the most recent hot lines, a block at a
+ * time, then write blocks older than the spill limit to the spill file. A
+ * limit of zero disables each; lines to be spilled are always compressed.
+ */
+void
+grid_freeze_history(struct grid *gd, u_int hot, u_int spill)
+{
+	struct grid_line	*gl;
+
+	if (spill != 0 && (hot == 0 || hot > spill))
+		hot = spill;
+	if (hot == 0)
+		return;
+
+	if (gd->hfrozen > gd->hsize)
+		gd->hfrozen = gd->hsize;
+	while (gd->hsize - gd->hfrozen >= hot + GRID_BLOCK_LINES) {
+		grid_freeze_lines(gd, gd->hfrozen, GRID_BLOCK_LINES);
+		gd->hfrozen += GRID_BLOCK_LINES;
+	}
+
+	if (spill == 0 || gd->spillfd == -1)
+		return;
+
+	if (gd->hspilled > gd->hfrozen)
+		gd->hspilled = gd->hfrozen;
+	while (gd->hspilled < gd->hfrozen && gd->hsize - gd->hspilled > spill &&
+	    gd->spillfd != -1) {
+		gl = grid_get_line(gd, gd->hspilled);
+		if (gl->flags & GRID_LINE_COLD && gl->block->data != NULL)
+			grid_spill_block(gd, gl->block);
+		gd->hspilled++;
+	}
+}
+
+/* Count the bytes used by the history, including compressed blocks. */
+unsigned long long
+grid_history_bytes(struct grid *gd)
+{
+	struct grid_line	*gl;
+	unsigned long long	 size;
+	u_int			 yy;
+
+	size = 0;
+	for (yy = 0; yy < gd->hsize; yy++) {
+		gl = grid_get_line(gd, yy);
+		if (gl->flags & GRID_LINE_COMPACT) {
+			size += gl->cellsize * sizeof *gl->compactdata;
+			size += gl->extdsize * sizeof *gl->extddata;
+		} else if (~gl->flags & GRID_LINE_COLD)
+			size += gl->cellsize * sizeof *gl->celldata;
+	}
+	size += gd->hsize * sizeof *gd->linedata;
+	size += gd->coldbytes;
+
+	return (size);
 }
 
 /* Expand line to fit to cell. */
@@ -219,7 +973,8 @@ grid_expand_line(struct grid *gd, u_int py, u_int sx)
 	struct grid_line	*gl;
 	u_int			 xx;
 
-	gl = &gd->linedata[py];
+	gl = grid_get_line(gd, py);
+	grid_uncompact_line(gd, gl);
 	if (sx <= gl->cellsize)
 		return;
 
@@ -235,19 +990,24 @@ grid_peek_line(struct grid *gd, u_int py)
 {
 	if (grid_check_y(gd, py) != 0)
 		return (NULL);
-	return (&gd->linedata[py]);
+	return (grid_get_line(gd, py));
 }
 
 /* Get cell for reading. */
 const struct grid_cell *
 grid_peek_cell(struct grid *gd, u_int px, u_int py)
 {
+	const struct grid_line	*gl;
+
 	if (grid_check_y(gd, py) != 0)
 		return (&grid_default_cell);
 
-	if (px >= gd->linedata[py].cellsize)
+	gl = grid_get_line(gd, py);
+	if (px >= gl->cellsize)
 		return (&grid_default_cell);
-	return (&gd->linedata[py].celldata[px]);
+	if (gl->flags & (GRID_LINE_COMPACT|GRID_LINE_COLD))
+		return (&grid_decode_line(gd, gl)[px]);
+	return (&gl->celldata[px]);
 }
 
 /* Get cell at relative position (for writing). */
@@ -258,7 +1018,7 @@ grid_get_cell(struct grid *gd, u_int px, u_int py)
 		return (NULL);
 
 	grid_expand_line(gd, py, px + 1);
-	return (&gd->linedata[py].celldata[px]);
+	return (&grid_get_line(gd, py)->celldata[px]);
 }
 
 /* Set cell at relative position. */
@@ -272,11 +1032,31 @@ grid_set_cell(struct grid *gd, u_int px, u_int py, const struct grid_cell *gc)
 	grid_put_cell(gd, px, py, gc);
 }
 
+/* Set cells at relative position from a string of ASCII characters. */
+void
+grid_set_cells(struct grid *gd, u_int px, u_int py, const struct grid_cell *gc,
+    const u_char *s, size_t slen)
+{
+	struct grid_cell	*gcp;
+	size_t			 i;
+
+	if (grid_check_y(gd, py) != 0)
+		return;
+
+	grid_expand_line(gd, py, px + slen);
+	gcp = &grid_get_line(gd, py)->celldata[px];
+	for (i = 0; i < slen; i++) {
+		memcpy(&gcp[i], gc, sizeof gcp[i]);
+		grid_cell_one(&gcp[i], s[i]);
+	}
+}
+
 /* Clear area. */
 void
 grid_clear(struct grid *gd, u_int px, u_int py, u_int nx, u_int ny)
 {
-	u_int	xx, yy;
+	struct grid_line	*gl;
+	u_int			 xx, yy;
 
 	if (nx == 0 || ny == 0)
 		return;
@@ -292,14 +1072,16 @@ grid_clear(struct grid *gd, u_int px, u_int py, u_int nx, u_int ny)
 		return;
 
 	for (yy = py; yy < py + ny; yy++) {
-		if (px >= gd->linedata[yy].cellsize)
+		gl = grid_get_line(gd, yy);
+		if (px >= gl->cellsize)
 			continue;
-		if (px + nx >= gd->linedata[yy].cellsize) {
-			gd->linedata[yy].cellsize = px;
+		grid_uncompact_line(gd, gl);
+		if (px + nx >= gl->cellsize) {
+			gl->cellsize = px;
 			continue;
 		}
 		for (xx = px; xx < px + nx; xx++) {
-			if (xx >= gd->linedata[yy].cellsize)
+			if (xx >= gl->cellsize)
 				break;
 			grid_put_cell(gd, xx, yy, &grid_default_cell);
 		}
@@ -322,8 +1104,8 @@ grid_clear_lines(struct grid *gd, u_int py, u_int ny)
 		return;
 
 	for (yy = py; yy < py + ny; yy++) {
-		gl = &gd->linedata[yy];
-		free(gl->celldata);
+		gl = grid_get_line(gd, yy);
+		grid_free_line(gd, gl);
 		memset(gl, 0, sizeof *gl);
 	}
 }
@@ -353,14 +1135,25 @@ grid_move_lines(struct grid *gd, u_int dy, u_int py, u_int ny)
 		grid_clear_lines(gd, yy, 1);
 	}
 
-	memmove(
-	    &gd->linedata[dy], &gd->linedata[py], ny * (sizeof *gd->linedata));
+	/* Move the lines, in the right order if they overlap. */
+	if (dy < py) {
+		for (yy = 0; yy < ny; yy++) {
+			memcpy(grid_get_line(gd, dy + yy),
+			    grid_get_line(gd, py + yy), sizeof *gd->linedata);
+		}
+	} else {
+		for (yy = ny; yy > 0; yy--) {
+			memcpy(grid_get_line(gd, dy + yy - 1),
+			    grid_get_line(gd, py + yy - 1),
+			    sizeof *gd->linedata);
+		}
+	}
 
 	/* Wipe any lines that have been moved (without freeing them). */
 	for (yy = py; yy < py + ny; yy++) {
 		if (yy >= dy && yy < dy + ny)
 			continue;
-		memset(&gd->linedata[yy], 0, sizeof gd->linedata[yy]);
+		memset(grid_get_line(gd, yy), 0, sizeof *gd->linedata);
 	}
 }
 
@@ -376,7 +1169,7 @@ grid_move_cells(struct grid *gd, u_int dx, u_int px, u_int py, u_int nx)
 
 	if (grid_check_y(gd, py) != 0)
 		return;
-	gl = &gd->linedata[py];
+	gl = grid_get_line(gd, py);
 
 	grid_expand_line(gd, py, px + nx);
 	grid_expand_line(gd, py, dx + nx);
@@ -591,7 +1384,7 @@ grid_string_cells(struct grid *gd, u_int px, u_int py, u_int nx,
 	for (xx = px; xx < px + nx; xx++) {
 		if (gl == NULL || xx >= gl->cellsize)
 			break;
-		gc = &gl->celldata[xx];
+		gc = grid_peek_cell(gd, xx, py);
 		if (gc->flags & GRID_FLAG_PADDING)
 			continue;
 		grid_cell_get(gc, &ud);
@@ -652,11 +1445,25 @@ grid_duplicate_lines(struct grid *dst, u_int dy, struct grid *src, u_int sy,
 	grid_clear_lines(dst, dy, ny);
 
 	for (yy = 0; yy < ny; yy++) {
-		srcl = &src->linedata[sy];
-		dstl = &dst->linedata[dy];
+		srcl = grid_get_line(src, sy);
+		dstl = grid_get_line(dst, dy);
+
+		if (srcl->flags & GRID_LINE_COLD)
+			grid_uncompact_line(src, srcl);
 
 		memcpy(dstl, srcl, sizeof *dstl);
-		if (srcl->cellsize != 0) {
+		if (srcl->flags & GRID_LINE_COMPACT) {
+			dstl->compactdata = xcalloc(
+			    srcl->cellsize, sizeof *dstl->compactdata);
+			memcpy(dstl->compactdata, srcl->compactdata,
+			    srcl->cellsize * sizeof *dstl->compactdata);
+			if (srcl->extdsize != 0) {
+				dstl->extddata = xcalloc(
+				    srcl->extdsize, sizeof *dstl->extddata);
+				memcpy(dstl->extddata, srcl->extddata,
+				    srcl->extdsize * sizeof *dstl->extddata);
+			}
+		} else if (srcl->cellsize != 0) {
 			dstl->celldata = xcalloc(
 			    srcl->cellsize, sizeof *dstl->celldata);
 			memcpy(dstl->celldata, srcl->celldata,
@@ -673,9 +1480,12 @@ void
 grid_reflow_join(struct grid *dst, u_int *py, struct grid_line *src_gl,
     u_int new_x)
 {
-	struct grid_line	*dst_gl = &dst->linedata[(*py) - 1];
+	struct grid_line	*dst_gl = grid_get_line(dst, (*py) - 1);
 	u_int			 left, to_copy, ox, nx;
 
+	/* The line may already have been compacted into the history. */
+	grid_uncompact_line(dst, dst_gl);
+
 	/* How much is left on the old line? */
 	left = new_x - dst_gl->cellsize;
 
@@ -717,7 +1527,7 @@ grid_reflow_split(struct grid *dst, u_int *py, struct grid_line *src_gl,
 		/* Create new line. */
 		if (*py >= dst->hsize + dst->sy)
 			grid_scroll_history(dst);
-		dst_gl = &dst->linedata[*py];
+		dst_gl = grid_get_line(dst, *py);
 		(*py)++;
 
 		/* How much should we copy? */
@@ -754,7 +1564,7 @@ grid_reflow_move(struct grid *dst, u_int *py, struct grid_line *src_gl)
 	/* Create new line. */
 	if (*py >= dst->hsize + dst->sy)
 		grid_scroll_history(dst);
-	dst_gl = &dst->linedata[*py];
+	dst_gl = grid_get_line(dst, *py);
 	(*py)++;
 
 	/* Copy the old line. */
@@ -766,38 +1576,154 @@ grid_reflow_move(struct grid *dst, u_int *py, struct grid_line *src_gl)
 }
 
 /*
- * Reflow lines from src grid into dst grid of width new_x. Returns number of
- * lines fewer in the visible area. The source grid is destroyed.
+ * Find the first line that must be reflowed to width new_x to fill sy lines at
+ * the end of the grid. This is always the start of a wrapped line.
  */
 u_int
-grid_reflow(struct grid *dst, struct grid *src, u_int new_x)
+grid_reflow_start(struct grid *gd, u_int new_x, u_int sy)
 {
-	u_int			 py, sy, line;
+	struct grid_line	*gl;
+	u_int			 py, yy, n, cells;
+
+	py = gd->hsize + gd->sy;
+	n = 0;
+	while (py > 0 && n < sy) {
+		yy = py - 1;
+		cells = grid_get_line(gd, yy)->cellsize;
+		while (yy > 0) {
+			gl = grid_get_line(gd, yy - 1);
+			if (~gl->flags & GRID_LINE_WRAPPED)
+				break;
+			cells += gl->cellsize;
+			yy--;
+		}
+
+		/* Each wrapped line becomes as many lines as it fills. */
+		if (cells == 0)
+			n++;
+		else
+			n += (cells + new_x - 1) / new_x;
+		py = yy;
+	}
+	return (py);
+}
+
+/*
+ * Reflow ny lines from py to width new_x, replacing them in the grid. The
+ * lines must hold whole wrapped lines and either start at the top of the
+ * history or run to the end of the grid. At least sy lines are used for the
+ * result; returns the number of lines filled.
+ */
+u_int
+grid_reflow_lines(struct grid *gd, u_int py, u_int ny, u_int new_x, u_int sy)
+{
+	struct grid		*dst;
+	struct grid_line	*src_gl, *dst_gl;
+	u_int			 yy, dy, n;
 	int			 previous_wrapped;
-	struct grid_line	*src_gl;
 
-	py = 0;
-	sy = src->sy;
+	dst = grid_create(gd->sx, sy, gd->hlimit);
 
+	dy = 0;
 	previous_wrapped = 0;
-	for (line = 0; line < sy + src->hsize; line++) {
-		src_gl = src->linedata + line;
+	for (yy = py; yy < py + ny; yy++) {
+		src_gl = grid_get_line(gd, yy);
+		grid_uncompact_line(gd, src_gl);
 		if (!previous_wrapped) {
 			/* Wasn't wrapped. If smaller, move to destination. */
 			if (src_gl->cellsize <= new_x)
-				grid_reflow_move(dst, &py, src_gl);
+				grid_reflow_move(dst, &dy, src_gl);
 			else
-				grid_reflow_split(dst, &py, src_gl, new_x, 0);
+				grid_reflow_split(dst, &dy, src_gl, new_x, 0);
 		} else {
 			/* Previous was wrapped. Try to join. */
-			grid_reflow_join(dst, &py, src_gl, new_x);
+			grid_reflow_join(dst, &dy, src_gl, new_x);
 		}
 		previous_wrapped = src_gl->flags & GRID_LINE_WRAPPED;
+
+		grid_free_line(gd, src_gl);
+		memset(src_gl, 0, sizeof *src_gl);
 	}
+	n = dst->hsize + dst->sy;
+
+	/* Make space, moving the start of the buffer if at the top. */
+	if (n > ny)
+		grid_reserve_lines(gd, gd->hsize + gd->sy + n - ny);
+	if (py == 0 && n > ny) {
+		gd->lineoffset += gd->linesize - (n - ny);
+		if (gd->lineoffset >= gd->linesize)
+			gd->lineoffset -= gd->linesize;
+	} else if (py == 0) {
+		gd->lineoffset += ny - n;
+		if (gd->lineoffset >= gd->linesize)
+			gd->lineoffset -= gd->linesize;
+	}
+
+	for (yy = 0; yy < n; yy++) {
+		dst_gl = grid_get_line(dst, yy);
+		memcpy(grid_get_line(gd, py + yy), dst_gl, sizeof *dst_gl);
+		memset(dst_gl, 0, sizeof *dst_gl);
+	}
+	grid_destroy(dst);
 
-	grid_destroy(src);
+	return (dy);
+}
 
-	if (py > sy)
+/*
+ * Reflow the grid to width new_x. Only as many lines as are needed to fill
+ * the visible area are reflowed; older history is left for
+ * grid_reflow_history. Returns number of lines fewer in the visible area.
+ */
+u_int
+grid_reflow(struct grid *gd, u_int new_x)
+{
+	u_int	py, dy, sy;
+
+	sy = gd->sy;
+	py = grid_reflow_start(gd, new_x, sy);
+
+	dy = grid_reflow_lines(gd, py, gd->hsize + sy - py, new_x, sy);
+	if (dy > sy)
+		gd->hsize = py + dy - sy;
+	else
+		gd->hsize = py;
+
+	gd->hreflow = py;
+	if (gd->hfrozen > py)
+		gd->hfrozen = py;
+	if (gd->hspilled > py)
+		gd->hspilled = py;
+
+	if (dy > sy)
 		return (0);
-	return (sy - py);
+	return (sy - dy);
+}
+
+/* Reflow history lines left at an old width by grid_reflow. */
+void
+grid_reflow_history(struct grid *gd)
+{
+	u_int	ny, dy;
+
+	/*
+	 * If the visible area has grown into the lines, stop before any
+	 * wrapped line it has taken.
+	 */
+	ny = gd->hreflow;
+	if (ny > gd->hsize) {
+		ny = gd->hsize;
+		while (ny > 0 &&
+		    grid_get_line(gd, ny - 1)->flags & GRID_LINE_WRAPPED)
+			ny--;
+	}
+	gd->hreflow = 0;
+	if (ny == 0)
+		return;
+
+	dy = grid_reflow_lines(gd, 0, ny, gd->sx, 1);
+	grid_compact_line(grid_get_line(gd, dy - 1));
+	gd->hsize = gd->hsize - ny + dy;
+
+	gd->hfrozen = 0;
+	gd->hspilled = 0;
 }
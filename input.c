@@ -53,6 +53,7 @@ int	input_get(struct input_ctx *, u_int, int, int);
 void	input_reply(struct input_ctx *, const char *, ...);
 void	input_set_state(struct window_pane *, const struct input_transition *);
 void	input_reset_cell(struct input_ctx *);
+size_t	input_print_run(struct input_ctx *, const u_char *, size_t);
 
 /* Transition entry/exit handlers. */
 void	input_clear(struct input_ctx *);
@@ -215,6 +216,9 @@ struct input_state {
 	void				(*enter)(struct input_ctx *);
 	void				(*exit)(struct input_ctx *);
 	const struct input_transition	*transitions;
+
+	/* Transition for each byte, built by input_build. */
+	const struct input_transition	**lookup;
 };
 
 /* State transitions available from all states. */
@@ -246,143 +250,167 @@ const struct input_transition input_state_utf8_two_table[];
 const struct input_transition input_state_utf8_one_table[];
 
 /* ground state definition. */
-const struct input_state input_state_ground = {
+struct input_state input_state_ground = {
 	"ground",
 	input_ground, NULL,
-	input_state_ground_table
+	input_state_ground_table, NULL
 };
 
 /* esc_enter state definition. */
-const struct input_state input_state_esc_enter = {
+struct input_state input_state_esc_enter = {
 	"esc_enter",
 	input_clear, NULL,
-	input_state_esc_enter_table
+	input_state_esc_enter_table, NULL
 };
 
 /* esc_intermediate state definition. */
-const struct input_state input_state_esc_intermediate = {
+struct input_state input_state_esc_intermediate = {
 	"esc_intermediate",
 	NULL, NULL,
-	input_state_esc_intermediate_table
+	input_state_esc_intermediate_table, NULL
 };
 
 /* csi_enter state definition. */
-const struct input_state input_state_csi_enter = {
+struct input_state input_state_csi_enter = {
 	"csi_enter",
 	input_clear, NULL,
-	input_state_csi_enter_table
+	input_state_csi_enter_table, NULL
 };
 
 /* csi_parameter state definition. */
-const struct input_state input_state_csi_parameter = {
+struct input_state input_state_csi_parameter = {
 	"csi_parameter",
 	NULL, NULL,
-	input_state_csi_parameter_table
+	input_state_csi_parameter_table, NULL
 };
 
 /* csi_intermediate state definition. */
-const struct input_state input_state_csi_intermediate = {
+struct input_state input_state_csi_intermediate = {
 	"csi_intermediate",
 	NULL, NULL,
-	input_state_csi_intermediate_table
+	input_state_csi_intermediate_table, NULL
 };
 
 /* csi_ignore state definition. */
-const struct input_state input_state_csi_ignore = {
+struct input_state input_state_csi_ignore = {
 	"csi_ignore",
 	NULL, NULL,
-	input_state_csi_ignore_table
+	input_state_csi_ignore_table, NULL
 };
 
 /* dcs_enter state definition. */
-const struct input_state input_state_dcs_enter = {
+struct input_state input_state_dcs_enter = {
 	"dcs_enter",
 	input_clear, NULL,
-	input_state_dcs_enter_table
+	input_state_dcs_enter_table, NULL
 };
 
 /* dcs_parameter state definition. */
-const struct input_state input_state_dcs_parameter = {
+struct input_state input_state_dcs_parameter = {
 	"dcs_parameter",
 	NULL, NULL,
-	input_state_dcs_parameter_table
+	input_state_dcs_parameter_table, NULL
 };
 
 /* dcs_intermediate state definition. */
-const struct input_state input_state_dcs_intermediate = {
+struct input_state input_state_dcs_intermediate = {
 	"dcs_intermediate",
 	NULL, NULL,
-	input_state_dcs_intermediate_table
+	input_state_dcs_intermediate_table, NULL
 };
 
 /* dcs_handler state definition. */
-const struct input_state input_state_dcs_handler = {
+struct input_state input_state_dcs_handler = {
 	"dcs_handler",
 	NULL, NULL,
-	input_state_dcs_handler_table
+	input_state_dcs_handler_table, NULL
 };
 
 /* dcs_escape state definition. */
-const struct input_state input_state_dcs_escape = {
+struct input_state input_state_dcs_escape = {
 	"dcs_escape",
 	NULL, NULL,
-	input_state_dcs_escape_table
+	input_state_dcs_escape_table, NULL
 };
 
 /* dcs_ignore state definition. */
-const struct input_state input_state_dcs_ignore = {
+struct input_state input_state_dcs_ignore = {
 	"dcs_ignore",
 	NULL, NULL,
-	input_state_dcs_ignore_table
+	input_state_dcs_ignore_table, NULL
 };
 
 /* osc_string state definition. */
-const struct input_state input_state_osc_string = {
+struct input_state input_state_osc_string = {
 	"osc_string",
 	input_enter_osc, input_exit_osc,
-	input_state_osc_string_table
+	input_state_osc_string_table, NULL
 };
 
 /* apc_string state definition. */
-const struct input_state input_state_apc_string = {
+struct input_state input_state_apc_string = {
 	"apc_string",
 	input_enter_apc, input_exit_apc,
-	input_state_apc_string_table
+	input_state_apc_string_table, NULL
 };
 
 /* rename_string state definition. */
-const struct input_state input_state_rename_string = {
+struct input_state input_state_rename_string = {
 	"rename_string",
 	input_enter_rename, input_exit_rename,
-	input_state_rename_string_table
+	input_state_rename_string_table, NULL
 };
 
 /* consume_st state definition. */
-const struct input_state input_state_consume_st = {
+struct input_state input_state_consume_st = {
 	"consume_st",
 	NULL, NULL,
-	input_state_consume_st_table
+	input_state_consume_st_table, NULL
 };
 
 /* utf8_three state definition. */
-const struct input_state input_state_utf8_three = {
+struct input_state input_state_utf8_three = {
 	"utf8_three",
 	NULL, NULL,
-	input_state_utf8_three_table
+	input_state_utf8_three_table, NULL
 };
 
 /* utf8_two state definition. */
-const struct input_state input_state_utf8_two = {
+struct input_state input_state_utf8_two = {
 	"utf8_two",
 	NULL, NULL,
-	input_state_utf8_two_table
+	input_state_utf8_two_table, NULL
 };
 
 /* utf8_one state definition. */
-const struct input_state input_state_utf8_one = {
+struct input_state input_state_utf8_one = {
 	"utf8_one",
 	NULL, NULL,
-	input_state_utf8_one_table
+	input_state_utf8_one_table, NULL
+};
+
+/* All states, for input_build. */
+struct input_state *input_states[] = {
+	&input_state_ground,
+	&input_state_esc_enter,
+	&input_state_esc_intermediate,
+	&input_state_csi_enter,
+	&input_state_csi_parameter,
+	&input_state_csi_intermediate,
+	&input_state_csi_ignore,
+	&input_state_dcs_enter,
+	&input_state_dcs_parameter,
+	&input_state_dcs_intermediate,
+	&input_state_dcs_handler,
+	&input_state_dcs_escape,
+	&input_state_dcs_ignore,
+	&input_state_osc_string,
+	&input_state_apc_string,
+	&input_state_rename_string,
+	&input_state_consume_st,
+	&input_state_utf8_three,
+	&input_state_utf8_two,
+	&input_state_utf8_one,
 };
 
 /* ground state table. */
@@ -689,6 +717,34 @@ input_table_compare(const void *key, const void *value)
 	return (strcmp(ictx->interm_buf, entry->interm));
 }
 
+/* Build transition lookup tables for each state. */
+void
+input_build(void)
+{
+	struct input_state		*state;
+	const struct input_transition	*itr;
+	u_int				 i, ch;
+
+	for (i = 0; i < nitems(input_states); i++) {
+		state = input_states[i];
+		state->lookup = xcalloc(256, sizeof *state->lookup);
+		for (ch = 0; ch < 256; ch++) {
+			itr = state->transitions;
+			while (itr->first != -1 && itr->last != -1) {
+				if ((int)ch >= itr->first &&
+				    (int)ch <= itr->last)
+					break;
+				itr++;
+			}
+			if (itr->first == -1 || itr->last == -1) {
+				/* No transition? Eh? */
+				fatalx("No transition from state!");
+			}
+			state->lookup[ch] = itr;
+		}
+	}
+}
+
 /* Reset cell state to default. */
 void
 input_reset_cell(struct input_ctx *ictx)
@@ -785,20 +841,21 @@ input_parse(struct window_pane *wp)
 
 	/* Parse the input. */
 	while (off < len) {
+		/*
+		 * Printable ASCII in the ground state doesn't change state, so
+		 * pass runs of it straight to the screen.
+		 */
+		if (ictx->state == &input_state_ground &&
+		    buf[off] >= 0x20 && buf[off] <= 0x7e) {
+			off += input_print_run(ictx, buf + off, len - off);
+			continue;
+		}
+
 		ictx->ch = buf[off++];
-		log_debug("%s: '%c' %s", __func__, ictx->ch, ictx->state->name);
+		log_input("%s: '%c' %s", __func__, ictx->ch, ictx->state->name);
 
 		/* Find the transition. */
-		itr = ictx->state->transitions;
-		while (itr->first != -1 && itr->last != -1) {
-			if (ictx->ch >= itr->first && ictx->ch <= itr->last)
-				break;
-			itr++;
-		}
-		if (itr->first == -1 || itr->last == -1) {
-			/* No transition? Eh? */
-			fatalx("No transition from state!");
-		}
+		itr = ictx->state->lookup[ictx->ch];
 
 		/*
 		 * Execute the handler, if any. Don't switch state if it
@@ -933,6 +990,32 @@ input_print(struct input_ctx *ictx)
 	return (0);
 }
 
+/* Output a run of printable ASCII, returning the number of bytes used. */
+size_t
+input_print_run(struct input_ctx *ictx, const u_char *buf, size_t len)
+{
+	struct grid_cell	*gc = &ictx->cell.cell;
+	size_t			 n;
+	int			 set;
+
+	set = ictx->cell.set == 0 ? ictx->cell.g0set : ictx->cell.g1set;
+	if (set == 1)
+		gc->attr |= GRID_ATTR_CHARSET;
+	else
+		gc->attr &= ~GRID_ATTR_CHARSET;
+
+	for (n = 0; n < len; n++) {
+		if (buf[n] < 0x20 || buf[n] > 0x7e)
+			break;
+	}
+	screen_write_cells(&ictx->ctx, gc, buf, n);
+	ictx->ch = buf[n - 1];
+
+	gc->attr &= ~GRID_ATTR_CHARSET;
+
+	return (n);
+}
+
 /* Collect intermediate string. */
 int
 input_intermediate(struct input_ctx *ictx)
@@ -992,7 +1075,7 @@ input_c0_dispatch(struct input_ctx *ictx)
 	struct screen		*s = sctx->s;
 	u_int			 trigger;
 
-	log_debug("%s: '%c", __func__, ictx->ch);
+	log_input("%s: '%c", __func__, ictx->ch);
 
 	switch (ictx->ch) {
 	case '\000':	/* NUL */
@@ -1030,7 +1113,7 @@ input_c0_dispatch(struct input_ctx *ictx)
 		ictx->cell.set = 0;
 		break;
 	default:
-		log_debug("%s: unknown '%c'", __func__, ictx->ch);
+		log_input("%s: unknown '%c'", __func__, ictx->ch);
 		break;
 	}
 
@@ -1056,12 +1139,12 @@ input_esc_dispatch(struct input_ctx *ictx)
 
 	if (ictx->flags & INPUT_DISCARD)
 		return (0);
-	log_debug("%s: '%c', %s", __func__, ictx->ch, ictx->interm_buf);
+	log_input("%s: '%c', %s", __func__, ictx->ch, ictx->interm_buf);
 
 	entry = bsearch(ictx, input_esc_table, nitems(input_esc_table),
 	    sizeof input_esc_table[0], input_table_compare);
 	if (entry == NULL) {
-		log_debug("%s: unknown '%c'", __func__, ictx->ch);
+		log_input("%s: unknown '%c'", __func__, ictx->ch);
 		return (0);
 	}
 
@@ -1132,13 +1215,13 @@ input_csi_dispatch(struct input_ctx *ictx)
 		return (0);
 	if (input_split(ictx) != 0)
 		return (0);
-	log_debug("%s: '%c' \"%s\" \"%s\"",
+	log_input("%s: '%c' \"%s\" \"%s\"",
 	    __func__, ictx->ch, ictx->interm_buf, ictx->param_buf);
 
 	entry = bsearch(ictx, input_csi_table, nitems(input_csi_table),
 	    sizeof input_csi_table[0], input_table_compare);
 	if (entry == NULL) {
-		log_debug("%s: unknown '%c'", __func__, ictx->ch);
+		log_input("%s: unknown '%c'", __func__, ictx->ch);
 		return (0);
 	}
 
@@ -1186,7 +1269,7 @@ input_csi_dispatch(struct input_ctx *ictx)
 			input_reply(ictx, "\033[?1;2c");
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 		break;
@@ -1196,7 +1279,7 @@ input_csi_dispatch(struct input_ctx *ictx)
 			input_reply(ictx, "\033[>84;0;0c");
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 		break;
@@ -1223,7 +1306,7 @@ input_csi_dispatch(struct input_ctx *ictx)
 			input_reply(ictx, "\033[%u;%uR", s->cy + 1, s->cx + 1);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 		break;
@@ -1250,7 +1333,7 @@ input_csi_dispatch(struct input_ctx *ictx)
 			}
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 		break;
@@ -1266,7 +1349,7 @@ input_csi_dispatch(struct input_ctx *ictx)
 			screen_write_clearline(sctx);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 		break;
@@ -1314,7 +1397,7 @@ input_csi_dispatch(struct input_ctx *ictx)
 			bit_nclear(s->tabs, 0, screen_size_x(s) - 1);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 		break;
@@ -1346,7 +1429,7 @@ input_csi_dispatch_rm(struct input_ctx *ictx)
 			screen_write_mode_set(&ictx->ctx, MODE_BLINKING);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 	}
@@ -1402,7 +1485,7 @@ input_csi_dispatch_rm_private(struct input_ctx *ictx)
 			screen_write_mode_clear(&ictx->ctx, MODE_BRACKETPASTE);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 	}
@@ -1423,7 +1506,7 @@ input_csi_dispatch_sm(struct input_ctx *ictx)
 			screen_write_mode_clear(&ictx->ctx, MODE_BLINKING);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 	}
@@ -1485,7 +1568,7 @@ input_csi_dispatch_sm_private(struct input_ctx *ictx)
 			screen_write_mode_set(&ictx->ctx, MODE_BRACKETPASTE);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 	}
@@ -1533,7 +1616,7 @@ input_csi_dispatch_winops(struct input_ctx *ictx)
 			input_reply(ictx, "\033[8;%u;%u", wp->sy, wp->sx);
 			break;
 		default:
-			log_debug("%s: unknown '%c'", __func__, ictx->ch);
+			log_input("%s: unknown '%c'", __func__, ictx->ch);
 			break;
 		}
 		m++;
@@ -1691,7 +1774,7 @@ input_dcs_dispatch(struct input_ctx *ictx)
 	if (ictx->flags & INPUT_DISCARD)
 		return (0);
 
-	log_debug("%s: \"%s\"", __func__, ictx->input_buf);
+	log_input("%s: \"%s\"", __func__, ictx->input_buf);
 
 	/* Check for tmux prefix. */
 	if (ictx->input_len >= prefix_len &&
@@ -1707,7 +1790,7 @@ input_dcs_dispatch(struct input_ctx *ictx)
 void
 input_enter_osc(struct input_ctx *ictx)
 {
-	log_debug("%s", __func__);
+	log_input("%s", __func__);
 
 	input_clear(ictx);
 }
@@ -1724,7 +1807,7 @@ input_exit_osc(struct input_ctx *ictx)
 	if (ictx->input_len < 1 || *p < '0' || *p > '9')
 		return;
 
-	log_debug("%s: \"%s\"", __func__, p);
+	log_input("%s: \"%s\"", __func__, p);
 
 	option = 0;
 	while (*p >= '0' && *p <= '9')
@@ -1747,7 +1830,7 @@ input_exit_osc(struct input_ctx *ictx)
 			screen_set_cursor_colour(ictx->ctx.s, "");
 		break;
 	default:
-		log_debug("%s: unknown '%u'", __func__, option);
+		log_input("%s: unknown '%u'", __func__, option);
 		break;
 	}
 }
@@ -1756,7 +1839,7 @@ input_exit_osc(struct input_ctx *ictx)
 void
 input_enter_apc(struct input_ctx *ictx)
 {
-	log_debug("%s", __func__);
+	log_input("%s", __func__);
 
 	input_clear(ictx);
 }
@@ -1767,7 +1850,7 @@ input_exit_apc(struct input_ctx *ictx)
 {
 	if (ictx->flags & INPUT_DISCARD)
 		return;
-	log_debug("%s: \"%s\"", __func__, ictx->input_buf);
+	log_input("%s: \"%s\"", __func__, ictx->input_buf);
 
 	screen_set_title(ictx->ctx.s, ictx->input_buf);
 	server_status_window(ictx->wp->window);
@@ -1777,7 +1860,7 @@ input_exit_apc(struct input_ctx *ictx)
 void
 input_enter_rename(struct input_ctx *ictx)
 {
-	log_debug("%s", __func__);
+	log_input("%s", __func__);
 
 	input_clear(ictx);
 }
@@ -1790,7 +1873,7 @@ input_exit_rename(struct input_ctx *ictx)
 		return;
 	if (!options_get_number(&ictx->wp->window->options, "allow-rename"))
 		return;
-	log_debug("%s: \"%s\"", __func__, ictx->input_buf);
+	log_input("%s: \"%s\"", __func__, ictx->input_buf);
 
 	window_set_name(ictx->wp->window, ictx->input_buf);
 	options_set_number(&ictx->wp->window->options, "automatic-rename", 0);
@@ -1807,7 +1890,7 @@ input_utf8_open(struct input_ctx *ictx)
 		input_print(ictx);
 		return (-1);
 	}
-	log_debug("%s", __func__);
+	log_input("%s", __func__);
 
 	utf8_open(&ictx->utf8data, ictx->ch);
 	return (0);
@@ -1817,7 +1900,7 @@ input_utf8_open(struct input_ctx *ictx)
 int
 input_utf8_add(struct input_ctx *ictx)
 {
-	log_debug("%s", __func__);
+	log_input("%s", __func__);
 
 	utf8_append(&ictx->utf8data, ictx->ch);
 	return (0);
@@ -1827,7 +1910,7 @@ input_utf8_add(struct input_ctx *ictx)
 int
 input_utf8_close(struct input_ctx *ictx)
 {
-	log_debug("%s", __func__);
+	log_input("%s", __func__);
 
 	utf8_append(&ictx->utf8data, ictx->ch);
 
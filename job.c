@@ -38,61 +38,74 @@ void	job_write_callback(struct bufferevent *, void *);
 /* All jobs list. */
 struct joblist	all_jobs = LIST_HEAD_INITIALIZER(all_jobs);
 
-/* Start a job running, if it isn't already. */
+/*
+ * Start a job running, if it isn't already. The child is started with vfork()
+ * so the server's memory does not have to be copied however big the history
+ * has grown; everything it needs is prepared first and it only makes system
+ * calls before exec.
+ */
 struct job *
 job_run(const char *cmd, struct session *s,
     void (*callbackfn)(struct job *), void (*freefn)(void *), void *data)
 {
 	struct job	*job;
 	struct environ	 env;
+	char		**envp;
+	sigset_t	 set, oldset;
 	pid_t		 pid;
-	int		 nullfd, out[2];
+	int		 nullfd, maxfd, out[2];
 
 	if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, out) != 0)
 		return (NULL);
+	nullfd = open(_PATH_DEVNULL, O_RDWR, 0);
+	if (nullfd == -1) {
+		close(out[0]);
+		close(out[1]);
+		return (NULL);
+	}
 
 	environ_init(&env);
 	environ_copy(&global_environ, &env);
 	if (s != NULL)
 		environ_copy(&s->environ, &env);
 	server_fill_environ(s, &env);
+	envp = environ_array(&env);
+	environ_free(&env);
 
-	switch (pid = fork()) {
+	maxfd = getdtablesize();
+
+	/* Block signals so the handlers cannot run in the child. */
+	sigfillset(&set);
+	sigprocmask(SIG_BLOCK, &set, &oldset);
+
+	switch (pid = vfork()) {
 	case -1:
-		environ_free(&env);
+		sigprocmask(SIG_SETMASK, &oldset, NULL);
+		environ_free_array(envp);
+		close(nullfd);
 		close(out[0]);
 		close(out[1]);
 		return (NULL);
 	case 0:		/* child */
 		clear_signals(1);
-
-		environ_push(&env);
-		environ_free(&env);
+		sigprocmask(SIG_SETMASK, &oldset, NULL);
 
 		if (dup2(out[1], STDIN_FILENO) == -1)
-			fatal("dup2 failed");
+			_exit(1);
 		if (dup2(out[1], STDOUT_FILENO) == -1)
-			fatal("dup2 failed");
-		if (out[1] != STDIN_FILENO && out[1] != STDOUT_FILENO)
-			close(out[1]);
-		close(out[0]);
-
-		nullfd = open(_PATH_DEVNULL, O_RDWR, 0);
-		if (nullfd < 0)
-			fatal("open failed");
+			_exit(1);
 		if (dup2(nullfd, STDERR_FILENO) == -1)
-			fatal("dup2 failed");
-		if (nullfd != STDERR_FILENO)
-			close(nullfd);
-
-		closefrom(STDERR_FILENO + 1);
+			_exit(1);
+		closefrom_vfork(STDERR_FILENO + 1, maxfd);
 
-		execl(_PATH_BSHELL, "sh", "-c", cmd, (char *) NULL);
-		fatal("execl failed");
+		execle(_PATH_BSHELL, "sh", "-c", cmd, (char *) NULL, envp);
+		_exit(1);
 	}
 
 	/* parent */
-	environ_free(&env);
+	sigprocmask(SIG_SETMASK, &oldset, NULL);
+	environ_free_array(envp);
+	close(nullfd);
 	close(out[1]);
 
 	job = xmalloc(sizeof *job);
@@ -113,7 +126,7 @@ job_run(const char *cmd, struct session *s,
 	    job_callback, job);
 	bufferevent_enable(job->event, EV_READ|EV_WRITE);
 
-	log_debug("run job %p: %s, pid %ld", job, job->cmd, (long) job->pid);
+	log_job("run job %p: %s, pid %ld", job, job->cmd, (long) job->pid);
 	return (job);
 }
 
@@ -121,7 +134,7 @@ job_run(const char *cmd, struct session *s,
 void
 job_free(struct job *job)
 {
-	log_debug("free job %p: %s", job, job->cmd);
+	log_job("free job %p: %s", job, job->cmd);
 
 	LIST_REMOVE(job, lentry);
 	free(job->cmd);
@@ -146,7 +159,7 @@ job_write_callback(unused struct bufferevent *bufev, void *data)
 	struct job	*job = data;
 	size_t		 len = EVBUFFER_LENGTH(EVBUFFER_OUTPUT(job->event));
 
-	log_debug("job write %p: %s, pid %ld, output left %zu", job, job->cmd,
+	log_job("job write %p: %s, pid %ld, output left %zu", job, job->cmd,
 	    (long) job->pid, len);
 
 	if (len == 0) {
@@ -161,7 +174,7 @@ job_callback(unused struct bufferevent *bufev, unused short events, void *data)
 {
 	struct job	*job = data;
 
-	log_debug("job error %p: %s, pid %ld", job, job->cmd, (long) job->pid);
+	log_job("job error %p: %s, pid %ld", job, job->cmd, (long) job->pid);
 
 	if (job->pid == -1) {
 		if (job->callbackfn != NULL)
@@ -178,7 +191,7 @@ job_callback(unused struct bufferevent *bufev, unused short events, void *data)
 void
 job_died(struct job *job, int status)
 {
-	log_debug("job died %p: %s, pid %ld", job, job->cmd, (long) job->pid);
+	log_job("job died %p: %s, pid %ld", job, job->cmd, (long) job->pid);
 
 	job->status = status;
 
@@ -20,16 +20,48 @@
 #include <time.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
-FILE	*log_file;
+/*
+ * Log messages are formatted into a fixed buffer which is written out when it
+ * fills, from a timer, or when the process exits.
+ */
+#define LOG_BUFSIZE 65536
+#define LOG_FLUSHTIME 100
+
+/* Subsystems being logged, zero if logging is off. */
+int		 log_flags;
+
+int		 log_fd = -1;
+pid_t		 log_pid;
+char		 log_buf[LOG_BUFSIZE];
+size_t		 log_used;
+struct event	 log_timer;
+
+struct log_subsystem {
+	const char	*name;
+	int		 flag;
+};
+const struct log_subsystem log_subsystems[] = {
+	{ "input", LOG_INPUT },
+	{ "tty", LOG_TTY },
+	{ "cmdq", LOG_CMDQ },
+	{ "job", LOG_JOB },
+	{ "other", LOG_OTHER },
+};
 
 void	 log_event_cb(int, const char *);
+int	 log_get_flags(void);
+void	 log_flush(void);
+void	 log_timer_cb(int, short, void *);
 void	 log_vwrite(const char *, va_list);
+void	 log_vfatal(const char *, va_list);
 
 /* Log callback for libevent. */
 void
@@ -38,16 +70,56 @@ log_event_cb(unused int severity, const char *msg)
 	log_debug("%s", msg);
 }
 
+/* Work out which subsystems to log from TMUX_LOG, or all if it is not set. */
+int
+log_get_flags(void)
+{
+	const char	*s;
+	char		*copy, *next, *name;
+	int		 flags;
+	u_int		 i;
+
+	if ((s = getenv("TMUX_LOG")) == NULL || *s == '\0')
+		return (LOG_ALL);
+
+	flags = 0;
+	copy = next = xstrdup(s);
+	while ((name = strsep(&next, ", ")) != NULL) {
+		for (i = 0; i < nitems(log_subsystems); i++) {
+			if (strcmp(name, log_subsystems[i].name) == 0)
+				flags |= log_subsystems[i].flag;
+		}
+	}
+	free(copy);
+	return (flags);
+}
+
 /* Open logging to file. */
 void
 log_open(const char *path)
 {
-	log_file = fopen(path, "w");
-	if (log_file == NULL)
+	/*
+	 * A forked server inherits the client log; anything left in the buffer
+	 * is the client's to write.
+	 */
+	if (log_fd != -1)
+		close(log_fd);
+	log_used = 0;
+	if (event_initialized(&log_timer))
+		evtimer_del(&log_timer);
+
+	log_fd = open(path, O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0644);
+	if (log_fd == -1) {
+		log_flags = 0;
 		return;
+	}
+	fcntl(log_fd, F_SETFD, FD_CLOEXEC);
+	log_pid = getpid();
+	log_flags = log_get_flags();
 
-	setvbuf(log_file, NULL, _IOLBF, 0);
+	evtimer_set(&log_timer, log_timer_cb, NULL);
 	event_set_log_callback(log_event_cb);
+	atexit(log_flush);
 
 	tzset();
 }
@@ -56,33 +128,96 @@ log_open(const char *path)
 void
 log_close(void)
 {
-	if (log_file != NULL)
-		fclose(log_file);
-	log_file = NULL;
+	log_flush();
+	if (log_fd != -1)
+		close(log_fd);
+	log_fd = -1;
+	log_flags = 0;
 
+	if (event_initialized(&log_timer))
+		evtimer_del(&log_timer);
 	event_set_log_callback(NULL);
 }
 
-/* Write a log message. */
+/*
+ * Write out the buffer. Forked children which exit without exec must not
+ * write their copy of the parent's buffer.
+ */
+void
+log_flush(void)
+{
+	size_t	off;
+	ssize_t	n;
+
+	if (log_fd == -1 || log_used == 0 || getpid() != log_pid)
+		return;
+
+	for (off = 0; off < log_used; off += n) {
+		n = write(log_fd, log_buf + off, log_used - off);
+		if (n == -1 && errno == EINTR)
+			n = 0;
+		else if (n <= 0)
+			break;
+	}
+	log_used = 0;
+}
+
+/* Flush timer callback. */
+void
+log_timer_cb(unused int fd, unused short events, unused void *arg)
+{
+	log_flush();
+}
+
+/* Format a log message into the buffer. */
 void
 log_vwrite(const char *msg, va_list ap)
 {
-	char	*fmt;
+	struct timeval	 tv;
+	char		*big;
+	size_t		 left;
+	int		 n;
+	va_list		 aq;
 
-	if (log_file == NULL)
+	if (log_fd == -1)
 		return;
 
-	if (asprintf(&fmt, "%s\n", msg) == -1)
-		exit(1);
-	if (vfprintf(log_file, fmt, ap) == -1)
-		exit(1);
-	fflush(log_file);
-	free(fmt);
+	for (;;) {
+		left = sizeof log_buf - log_used;
+
+		va_copy(aq, ap);
+		n = vsnprintf(log_buf + log_used, left, msg, aq);
+		va_end(aq);
+		if (n < 0)
+			return;
+		if ((size_t)n + 1 < left) {
+			log_used += n;
+			log_buf[log_used++] = '\n';
+			break;
+		}
+
+		/* Does not fit: write what there is and try again. */
+		if (log_used != 0) {
+			log_flush();
+			continue;
+		}
+		xvasprintf(&big, msg, ap);
+		if (write(log_fd, big, n) == -1 || write(log_fd, "\n", 1) == -1)
+			exit(1);
+		free(big);
+		return;
+	}
+
+	if (!evtimer_pending(&log_timer, NULL)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = LOG_FLUSHTIME * 1000L;
+		evtimer_add(&log_timer, &tv);
+	}
 }
 
-/* Log a debug message. */
+/* Log a debug message. Use log_debug() to check the subsystem first. */
 void
-log_debug(const char *msg, ...)
+log_write(const char *msg, ...)
 {
 	va_list	ap;
 
@@ -91,6 +226,18 @@ log_debug(const char *msg, ...)
 	va_end(ap);
 }
 
+/* Write a fatal error now, dropping any buffer copied from the parent. */
+void
+log_vfatal(const char *msg, va_list ap)
+{
+	if (getpid() != log_pid) {
+		log_used = 0;
+		log_pid = getpid();
+	}
+	log_vwrite(msg, ap);
+	log_flush();
+}
+
 /* Log a critical error with error string and die. */
 __dead void
 log_fatal(const char *msg, ...)
@@ -101,7 +248,7 @@ log_fatal(const char *msg, ...)
 	va_start(ap, msg);
 	if (asprintf(&fmt, "fatal: %s: %s", msg, strerror(errno)) == -1)
 		exit(1);
-	log_vwrite(fmt, ap);
+	log_vfatal(fmt, ap);
 	exit(1);
 }
 
@@ -115,6 +262,6 @@ log_fatalx(const char *msg, ...)
 	va_start(ap, msg);
 	if (asprintf(&fmt, "fatal: %s", msg) == -1)
 		exit(1);
-	log_vwrite(fmt, ap);
+	log_vfatal(fmt, ap);
 	exit(1);
 }
@@ -22,40 +22,104 @@
 #include <libgen.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "tmux.h"
 
 void	 window_name_callback(unused int, unused short, void *);
+void	 window_name_update(struct window *);
+
+/*
+ * Windows waiting for their name to be checked. Windows are queued when a pane
+ * has output or changes mode or when the active pane or its foreground process
+ * group changes, and are all checked together when the timer fires.
+ */
+TAILQ_HEAD(, window) window_name_queue =
+    TAILQ_HEAD_INITIALIZER(window_name_queue);
+struct event window_name_timer;
 
 void
 queue_window_name(struct window *w)
 {
 	struct timeval	tv;
 
-	tv.tv_sec = 0;
-	tv.tv_usec = NAME_INTERVAL * 1000L;
+	if (w->flags & WINDOW_NAMEQUEUED)
+		return;
+	if (!options_get_number(&w->options, "automatic-rename"))
+		return;
+	w->flags |= WINDOW_NAMEQUEUED;
+	TAILQ_INSERT_TAIL(&window_name_queue, w, name_entry);
+
+	if (!event_initialized(&window_name_timer))
+		evtimer_set(&window_name_timer, window_name_callback, NULL);
+	if (!evtimer_pending(&window_name_timer, NULL)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = NAME_INTERVAL * 1000L;
+		evtimer_add(&window_name_timer, &tv);
+	}
+}
 
-	if (event_initialized(&w->name_timer))
-		evtimer_del(&w->name_timer);
-	evtimer_set(&w->name_timer, window_name_callback, w);
-	evtimer_add(&w->name_timer, &tv);
+void
+unqueue_window_name(struct window *w)
+{
+	if (~w->flags & WINDOW_NAMEQUEUED)
+		return;
+	w->flags &= ~WINDOW_NAMEQUEUED;
+	TAILQ_REMOVE(&window_name_queue, w, name_entry);
 }
 
+/*
+ * Check a window now if its active pane or foreground process changed, if it
+ * had output in the last few seconds or if it has not been checked for a
+ * while.
+ */
 void
-window_name_callback(unused int fd, unused short events, void *data)
+check_window_name(struct window *w)
 {
-	struct window	*w = data;
-	char		*name;
+	struct window_pane	*wp = w->active;
+	pid_t			 pgrp;
 
-	if (w->active == NULL)
+	if (wp == NULL || (w->flags & WINDOW_NAMEQUEUED))
 		return;
-
-	if (!options_get_number(&w->options, "automatic-rename")) {
-		if (event_initialized(&w->name_timer))
-			event_del(&w->name_timer);
+	if (!options_get_number(&w->options, "automatic-rename"))
 		return;
+
+	pgrp = wp->fd == -1 ? -1 : tcgetpgrp(wp->fd);
+	if (wp->id != w->name_pane || pgrp != w->name_pgrp)
+		window_name_update(w);
+	else if (w->name_checks != 0) {
+		w->name_checks--;
+		window_name_update(w);
+	} else if (time(NULL) - w->name_time >= NAME_RECHECK)
+		window_name_update(w);
+}
+
+void
+window_name_callback(unused int fd, unused short events, unused void *data)
+{
+	struct window	*w;
+
+	while ((w = TAILQ_FIRST(&window_name_queue)) != NULL) {
+		unqueue_window_name(w);
+		if (w->active == NULL)
+			continue;
+		if (!options_get_number(&w->options, "automatic-rename"))
+			continue;
+		window_name_update(w);
+		w->name_checks = NAME_CHECKS;
 	}
-	queue_window_name(w);
+}
+
+void
+window_name_update(struct window *w)
+{
+	struct window_pane	*wp = w->active;
+	char			*name;
+
+	w->name_pane = wp->id;
+	w->name_pgrp = wp->fd == -1 ? -1 : tcgetpgrp(wp->fd);
+	w->name_time = time(NULL);
 
 	name = format_window_name(w);
 	if (strcmp(name, w->name) != 0) {
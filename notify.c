@@ -134,9 +134,6 @@ notify_drain(void)
 void
 notify_input(struct window_pane *wp, struct evbuffer *input)
 {
-	struct client	*c;
-	u_int		 i;
-
 	/*
 	 * notify_input() is not queued and only does anything when
 	 * notifications are enabled.
@@ -144,11 +141,7 @@ notify_input(struct window_pane *wp, struct evbuffer *input)
 	if (!notify_enabled)
 		return;
 
-	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
-		c = ARRAY_ITEM(&clients, i);
-		if (c != NULL && (c->flags & CLIENT_CONTROL))
-			control_notify_input(c, wp, input);
-	}
+	control_notify_input(wp, input);
 }
 
 void
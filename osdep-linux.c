@@ -21,78 +21,168 @@
 #include <sys/param.h>
 
 #include <event.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "tmux.h"
 
+/*
+ * Cache of what was last read from /proc for the foreground process group of
+ * each pty, indexed by pty file descriptor. An entry is used while the process
+ * group is the same and for no more than OSDEP_CACHE_TIME seconds, so that
+ * formats, status lines and automatic-rename expanded for the same pane
+ * together share one read.
+ */
+#define OSDEP_CACHE_TIME 1
+struct osdep_cache {
+	pid_t	 pgrp;
+
+	time_t	 name_time;
+	char	*name;
+	size_t	 namesize;
+
+	time_t	 cwd_time;
+	char	 cwd[MAXPATHLEN + 1];
+};
+struct osdep_cache	*osdep_cache;
+u_int			 osdep_ncache;
+
+struct osdep_cache	*osdep_get_cache(int, pid_t *);
+ssize_t			 osdep_read(pid_t, const char *, char *, size_t);
+
+/* Find the cache entry for a pty, clearing it if the process group changed. */
+struct osdep_cache *
+osdep_get_cache(int fd, pid_t *pgrp)
+{
+	struct osdep_cache	*oc;
+	u_int			 i;
+
+	if (fd < 0 || (*pgrp = tcgetpgrp(fd)) == -1)
+		return (NULL);
+
+	if ((u_int) fd >= osdep_ncache) {
+		osdep_cache = xreallocarray(osdep_cache, fd + 1,
+		    sizeof *osdep_cache);
+		for (i = osdep_ncache; i <= (u_int) fd; i++) {
+			oc = &osdep_cache[i];
+			memset(oc, 0, sizeof *oc);
+			oc->pgrp = -1;
+		}
+		osdep_ncache = fd + 1;
+	}
+
+	oc = &osdep_cache[fd];
+	if (oc->pgrp != *pgrp) {
+		oc->pgrp = *pgrp;
+		oc->name_time = oc->cwd_time = 0;
+	}
+	return (oc);
+}
+
+/* Read a file in /proc for a process with one pread. */
+ssize_t
+osdep_read(pid_t pid, const char *name, char *buf, size_t size)
+{
+	char	path[64];
+	int	fd;
+	ssize_t	n;
+
+	xsnprintf(path, sizeof path, "/proc/%lld/%s", (long long) pid, name);
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return (-1);
+	n = pread(fd, buf, size, 0);
+	close(fd);
+	return (n);
+}
+
 char *
 osdep_get_name(int fd, unused char *tty)
 {
-	FILE	*f;
-	char	*path, *buf;
-	size_t	 len;
-	int	 ch;
-	pid_t	 pgrp;
+	struct osdep_cache	*oc;
+	static char		 buf[4096];
+	pid_t			 pgrp;
+	ssize_t			 n;
+	size_t			 len;
+	time_t			 t;
 
-	if ((pgrp = tcgetpgrp(fd)) == -1)
+	if ((oc = osdep_get_cache(fd, &pgrp)) == NULL)
 		return (NULL);
 
-	xasprintf(&path, "/proc/%lld/cmdline", (long long) pgrp);
-	if ((f = fopen(path, "r")) == NULL) {
-		free(path);
-		return (NULL);
+	t = time(NULL);
+	if (oc->name_time != 0 && t - oc->name_time < OSDEP_CACHE_TIME) {
+		osdep_cache_hits++;
+		goto out;
 	}
-	free(path);
-
-	len = 0;
-	buf = NULL;
-	while ((ch = fgetc(f)) != EOF) {
-		if (ch == '\0')
-			break;
-		buf = xrealloc(buf, len + 2);
-		buf[len++] = ch;
+	osdep_cache_misses++;
+
+	n = osdep_read(pgrp, "cmdline", buf, sizeof buf - 1);
+	if (n < 0)
+		n = 0;
+	buf[n] = '\0';
+
+	len = strlen(buf) + 1;
+	if (len > oc->namesize) {
+		oc->name = xrealloc(oc->name, len);
+		oc->namesize = len;
 	}
-	if (buf != NULL)
-		buf[len] = '\0';
+	memcpy(oc->name, buf, len);
+	oc->name_time = t;
 
-	fclose(f);
-	return (buf);
+out:
+	if (*oc->name == '\0')
+		return (NULL);
+	return (xstrdup(oc->name));
 }
 
 char *
 osdep_get_cwd(int fd)
 {
-	static char	 target[MAXPATHLEN + 1];
-	char		*path;
-	pid_t		 pgrp, sid;
-	ssize_t		 n;
+	struct osdep_cache	*oc;
+	char			 path[64];
+	pid_t			 pgrp, sid;
+	ssize_t			 n;
+	time_t			 t;
 
-	if ((pgrp = tcgetpgrp(fd)) == -1)
+	if ((oc = osdep_get_cache(fd, &pgrp)) == NULL)
 		return (NULL);
 
-	xasprintf(&path, "/proc/%lld/cwd", (long long) pgrp);
-	n = readlink(path, target, MAXPATHLEN);
-	free(path);
+	t = time(NULL);
+	if (oc->cwd_time != 0 && t - oc->cwd_time < OSDEP_CACHE_TIME) {
+		osdep_cache_hits++;
+		goto out;
+	}
+	osdep_cache_misses++;
+
+	xsnprintf(path, sizeof path, "/proc/%lld/cwd", (long long) pgrp);
+	n = readlink(path, oc->cwd, MAXPATHLEN);
 
 	if (n == -1 && ioctl(fd, TIOCGSID, &sid) != -1) {
-		xasprintf(&path, "/proc/%lld/cwd", (long long) sid);
-		n = readlink(path, target, MAXPATHLEN);
-		free(path);
+		xsnprintf(path, sizeof path, "/proc/%lld/cwd", (long long) sid);
+		n = readlink(path, oc->cwd, MAXPATHLEN);
 	}
 
-	if (n > 0) {
-		target[n] = '\0';
-		return (target);
-	}
-	return (NULL);
+	if (n < 0)
+		n = 0;
+	oc->cwd[n] = '\0';
+	oc->cwd_time = t;
+
+out:
+	if (*oc->cwd == '\0')
+		return (NULL);
+	return (oc->cwd);
 }
 
 struct event_base *
 osdep_event_init(void)
 {
-	/* On Linux, epoll doesn't work on /dev/null (yes, really). */
-	setenv("EVENT_NOEPOLL", "1", 1);
+	/*
+	 * On Linux, epoll doesn't work on /dev/null (yes, really). The server
+	 * only watches sockets, pipes and terminals and the client reads stdin
+	 * without waiting if it is a file or device, so epoll is safe to use.
+	 */
 	return (event_init());
 }
@@ -49,7 +49,7 @@ recalculate_sizes(void)
 	struct client		*c;
 	struct window		*w;
 	struct window_pane	*wp;
-	u_int			 i, j, ssx, ssy, has, limit;
+	u_int			 j, ssx, ssy, has, limit;
 	int			 flag, has_status, is_zoomed, forced;
 
 	RB_FOREACH(s, sessions, &sessions) {
@@ -92,9 +92,8 @@ recalculate_sizes(void)
 		s->sy = ssy;
 	}
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w == NULL || w->active == NULL)
+	RB_FOREACH(w, windows, &windows) {
+		if (w->active == NULL)
 			continue;
 		flag = options_get_number(&w->options, "aggressive-resize");
 
@@ -18,13 +18,17 @@
 
 #include <sys/types.h>
 
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "tmux.h"
 
 int	screen_redraw_cell_border1(struct window_pane *, u_int, u_int);
-int	screen_redraw_cell_border(struct client *, u_int, u_int);
-int	screen_redraw_check_cell(struct client *, u_int, u_int,
+int	screen_redraw_map_stale(struct window *, u_int, u_int);
+void	screen_redraw_build_map(struct window *, u_int, u_int);
+int	screen_redraw_border_type(int);
+int	screen_redraw_check_cell(struct window *, u_int, u_int,
 	    struct window_pane **);
 int	screen_redraw_check_active(u_int, u_int, int, struct window *,
 	    struct window_pane *);
@@ -79,102 +83,241 @@ screen_redraw_cell_border1(struct window_pane *wp, u_int px, u_int py)
 	return (-1);
 }
 
-/* Check if a cell is on the pane border. */
+/* Check if the map must be built again to cover sx by sy cells. */
 int
-screen_redraw_cell_border(struct client *c, u_int px, u_int py)
+screen_redraw_map_stale(struct window *w, u_int sx, u_int sy)
 {
-	struct window		*w = c->session->curw->window;
+	struct window_map	*map = w->map;
+	struct window_map_pane	*mp;
 	struct window_pane	*wp;
-	int			 retval;
+	u_int			 n;
 
-	/* Check all the panes. */
+	if (map == NULL || map->wsx != w->sx || map->wsy != w->sy)
+		return (1);
+	if (sx > map->sx || sy > map->sy)
+		return (1);
+
+	n = 0;
 	TAILQ_FOREACH(wp, &w->panes, entry) {
-		if (!window_pane_visible(wp))
-			continue;
-		if ((retval = screen_redraw_cell_border1(wp, px, py)) != -1)
-			return (retval);
+		if (n == map->npanes)
+			return (1);
+		mp = &map->panes[n++];
+		if (mp->wp != wp || mp->visible != window_pane_visible(wp))
+			return (1);
+		if (mp->xoff != wp->xoff || mp->yoff != wp->yoff)
+			return (1);
+		if (mp->sx != wp->sx || mp->sy != wp->sy)
+			return (1);
 	}
-
-	return (0);
+	return (n != map->npanes);
 }
 
-/* Check if cell inside a pane. */
-int
-screen_redraw_check_cell(struct client *c, u_int px, u_int py,
-    struct window_pane **wpp)
+/*
+ * Build the map. Each cell belongs to the first visible pane whose border
+ * surrounds it, so panes are filled in last to first. The border type of a
+ * cell depends on whether the cells around it are borders.
+ */
+void
+screen_redraw_build_map(struct window *w, u_int sx, u_int sy)
 {
-	struct window		*w = c->session->curw->window;
+	struct window_map	*map = w->map;
+	struct window_map_pane	*mp;
 	struct window_pane	*wp;
-	int			 borders;
+	u_char			*border;
+	u_int			 n, i, x, y, x0, y0, x1, y1, off;
+	int			 borders, inside;
+
+	map->wsx = w->sx;
+	map->wsy = w->sy;
+	map->sx = sx;
+	map->sy = sy;
+
+	n = 0;
+	TAILQ_FOREACH(wp, &w->panes, entry)
+		n++;
+	map->panes = xreallocarray(map->panes, n, sizeof *map->panes);
+	map->npanes = n;
+
+	n = 0;
+	TAILQ_FOREACH(wp, &w->panes, entry) {
+		mp = &map->panes[n++];
+		mp->wp = wp;
+		mp->xoff = wp->xoff;
+		mp->yoff = wp->yoff;
+		mp->sx = wp->sx;
+		mp->sy = wp->sy;
+		mp->visible = window_pane_visible(wp);
+	}
 
-	if (px > w->sx || py > w->sy)
-		return (CELL_OUTSIDE);
+	free(map->type);
+	free(map->pane);
+	free(map->at);
+	map->type = xcalloc(sx * sy, sizeof *map->type);
+	map->pane = xcalloc(sx * sy, sizeof *map->pane);
+	map->at = xcalloc(sx * sy, sizeof *map->at);
 
-	TAILQ_FOREACH(wp, &w->panes, entry) {
-		if (!window_pane_visible(wp))
-			continue;
-		*wpp = wp;
+	/* One extra column and row so the right and bottom can be checked. */
+	border = xcalloc((sx + 1) * (sy + 1), 1);
 
-		/* If outside the pane and its border, skip it. */
-		if ((wp->xoff != 0 && px < wp->xoff - 1) ||
-		    px > wp->xoff + wp->sx ||
-		    (wp->yoff != 0 && py < wp->yoff - 1) ||
-		    py > wp->yoff + wp->sy)
+	for (i = map->npanes; i > 0; i--) {
+		mp = &map->panes[i - 1];
+		if (!mp->visible || i > USHRT_MAX)
 			continue;
 
-		/* If definitely inside, return so. */
-		if (!screen_redraw_cell_border(c, px, py))
-			return (CELL_INSIDE);
-
-		/*
-		 * Construct a bitmask of whether the cells to the left (bit
-		 * 4), right, top, and bottom (bit 1) of this cell are borders.
-		 */
-		borders = 0;
-		if (px == 0 || screen_redraw_cell_border(c, px - 1, py))
-			borders |= 8;
-		if (px <= w->sx && screen_redraw_cell_border(c, px + 1, py))
-			borders |= 4;
-		if (py == 0 || screen_redraw_cell_border(c, px, py - 1))
-			borders |= 2;
-		if (py <= w->sy && screen_redraw_cell_border(c, px, py + 1))
-			borders |= 1;
-
-		/*
-		 * Figure out what kind of border this cell is. Only one bit
-		 * set doesn't make sense (can't have a border cell with no
-		 * others connected).
-		 */
-		switch (borders) {
-		case 15:	/* 1111, left right top bottom */
-			return (CELL_JOIN);
-		case 14:	/* 1110, left right top */
-			return (CELL_BOTTOMJOIN);
-		case 13:	/* 1101, left right bottom */
-			return (CELL_TOPJOIN);
-		case 12:	/* 1100, left right */
-			return (CELL_TOPBOTTOM);
-		case 11:	/* 1011, left top bottom */
-			return (CELL_RIGHTJOIN);
-		case 10:	/* 1010, left top */
-			return (CELL_BOTTOMRIGHT);
-		case 9:		/* 1001, left bottom */
-			return (CELL_TOPRIGHT);
-		case 7:		/* 0111, right top bottom */
-			return (CELL_LEFTJOIN);
-		case 6:		/* 0110, right top */
-			return (CELL_BOTTOMLEFT);
-		case 5:		/* 0101, right bottom */
-			return (CELL_TOPLEFT);
-		case 3:		/* 0011, top bottom */
-			return (CELL_LEFTRIGHT);
+		x0 = mp->xoff == 0 ? 0 : mp->xoff - 1;
+		y0 = mp->yoff == 0 ? 0 : mp->yoff - 1;
+		x1 = mp->xoff + mp->sx;
+		y1 = mp->yoff + mp->sy;
+		for (y = y0; y <= y1 && y <= sy; y++) {
+			for (x = x0; x <= x1 && x <= sx; x++) {
+				inside = (x >= mp->xoff && x < x1 &&
+				    y >= mp->yoff && y < y1);
+				border[y * (sx + 1) + x] = !inside;
+				if (x < sx && y < sy)
+					map->pane[y * sx + x] = i;
+			}
+		}
+
+		/* The mouse finds the pane plus its right and bottom border. */
+		for (y = mp->yoff; y <= y1 && y < sy; y++) {
+			for (x = mp->xoff; x <= x1 && x < sx; x++)
+				map->at[y * sx + x] = i;
 		}
 	}
 
-	*wpp = NULL;
+	for (y = 0; y < sy; y++) {
+		for (x = 0; x < sx; x++) {
+			off = y * sx + x;
+			if (map->pane[off] == 0) {
+				map->type[off] = CELL_OUTSIDE;
+				continue;
+			}
+			if (!border[y * (sx + 1) + x]) {
+				map->type[off] = CELL_INSIDE;
+				continue;
+			}
+
+			/*
+			 * Construct a bitmask of whether the cells to the left
+			 * (bit 4), right, top, and bottom (bit 1) of this cell
+			 * are borders.
+			 */
+			borders = 0;
+			if (x == 0 || border[y * (sx + 1) + x - 1])
+				borders |= 8;
+			if (border[y * (sx + 1) + x + 1])
+				borders |= 4;
+			if (y == 0 || border[(y - 1) * (sx + 1) + x])
+				borders |= 2;
+			if (border[(y + 1) * (sx + 1) + x])
+				borders |= 1;
+
+			map->type[off] = screen_redraw_border_type(borders);
+			if (map->type[off] == CELL_OUTSIDE)
+				map->pane[off] = 0;
+		}
+	}
+
+	free(border);
+}
+
+/*
+ * Get the map for a window, building it if the panes have changed or it does
+ * not cover at least sx by sy cells.
+ */
+struct window_map *
+screen_redraw_get_map(struct window *w, u_int sx, u_int sy)
+{
+	if (sx > w->sx + 1)
+		sx = w->sx + 1;
+	if (sy > w->sy + 1)
+		sy = w->sy + 1;
+
+	if (w->map == NULL)
+		w->map = xcalloc(1, sizeof *w->map);
+	else if (!screen_redraw_map_stale(w, sx, sy))
+		return (w->map);
+
+	/* Never build a smaller map than the last. */
+	if (w->map->wsx == w->sx && w->map->wsy == w->sy) {
+		if (sx < w->map->sx)
+			sx = w->map->sx;
+		if (sy < w->map->sy)
+			sy = w->map->sy;
+	}
+	screen_redraw_build_map(w, sx, sy);
+	return (w->map);
+}
+
+/* Free the map for a window. */
+void
+screen_redraw_free_map(struct window *w)
+{
+	struct window_map	*map = w->map;
+
+	if (map == NULL)
+		return;
+	free(map->panes);
+	free(map->type);
+	free(map->pane);
+	free(map->at);
+	free(map);
+	w->map = NULL;
+}
+
+/*
+ * Figure out what kind of border a cell is from whether the cells to the
+ * left, right, top and bottom are borders. Only one bit set doesn't make
+ * sense (can't have a border cell with no others connected).
+ */
+int
+screen_redraw_border_type(int borders)
+{
+	switch (borders) {
+	case 15:	/* 1111, left right top bottom */
+		return (CELL_JOIN);
+	case 14:	/* 1110, left right top */
+		return (CELL_BOTTOMJOIN);
+	case 13:	/* 1101, left right bottom */
+		return (CELL_TOPJOIN);
+	case 12:	/* 1100, left right */
+		return (CELL_TOPBOTTOM);
+	case 11:	/* 1011, left top bottom */
+		return (CELL_RIGHTJOIN);
+	case 10:	/* 1010, left top */
+		return (CELL_BOTTOMRIGHT);
+	case 9:		/* 1001, left bottom */
+		return (CELL_TOPRIGHT);
+	case 7:		/* 0111, right top bottom */
+		return (CELL_LEFTJOIN);
+	case 6:		/* 0110, right top */
+		return (CELL_BOTTOMLEFT);
+	case 5:		/* 0101, right bottom */
+		return (CELL_TOPLEFT);
+	case 3:		/* 0011, top bottom */
+		return (CELL_LEFTRIGHT);
+	}
 	return (CELL_OUTSIDE);
 }
 
+/* Look up the type of a cell and its pane in the map. */
+int
+screen_redraw_check_cell(struct window *w, u_int px, u_int py,
+    struct window_pane **wpp)
+{
+	struct window_map	*map = w->map;
+	u_int			 off, n;
+
+	*wpp = NULL;
+	if (px >= map->sx || py >= map->sy)
+		return (CELL_OUTSIDE);
+
+	off = py * map->sx + px;
+	if ((n = map->pane[off]) != 0)
+		*wpp = map->panes[n - 1].wp;
+	return (map->type[off]);
+}
+
 /* Check active pane indicator. */
 int
 screen_redraw_check_active(u_int px, u_int py, int type, struct window *w,
@@ -185,7 +328,7 @@ screen_redraw_check_active(u_int px, u_int py, int type, struct window *w,
 		return (0);
 
 	/* If there are more than two panes, that's enough. */
-	if (window_count_panes(w) != 2)
+	if (w->map->npanes != 2)
 		return (1);
 
 	/* Else if the cell is not a border cell, forget it. */
@@ -270,6 +413,27 @@ screen_redraw_pane(struct client *c, struct window_pane *wp)
 	tty_reset(&c->tty);
 }
 
+/* Redraw the changed lines of a pane. */
+void
+screen_redraw_dirty(struct client *c, struct window_pane *wp)
+{
+	u_int	i, yoff, lower;
+
+	if (!(wp->flags & PANE_DIRTY) || !window_pane_visible(wp))
+		return;
+
+	yoff = wp->yoff;
+	if (status_at_line(c) == 0)
+		yoff++;
+
+	lower = wp->dirty_lower;
+	if (lower > wp->sy - 1)
+		lower = wp->sy - 1;
+	for (i = wp->dirty_upper; i <= lower; i++)
+		tty_draw_line_diff(&c->tty, wp->screen, i, wp->xoff, yoff);
+	tty_reset(&c->tty);
+}
+
 /* Draw the borders. */
 void
 screen_redraw_draw_borders(struct client *c, int status, u_int top)
@@ -314,9 +478,10 @@ screen_redraw_draw_borders(struct client *c, int status, u_int top)
 	style_apply(&active_gc, oo, "pane-active-border-style");
 	active_gc.attr = other_gc.attr = GRID_ATTR_CHARSET;
 
+	screen_redraw_get_map(w, tty->sx, tty->sy - status);
 	for (j = 0; j < tty->sy - status; j++) {
 		for (i = 0; i < tty->sx; i++) {
-			type = screen_redraw_check_cell(c, i, j, &wp);
+			type = screen_redraw_check_cell(w, i, j, &wp);
 			if (type == CELL_INSIDE)
 				continue;
 			if (type == CELL_OUTSIDE &&
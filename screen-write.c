@@ -296,7 +296,7 @@ screen_write_copy(struct screen_write_ctx *ctx,
 {
 	struct screen		*s = ctx->s;
 	struct grid		*gd = src->grid;
-	struct grid_line	*gl;
+	const struct grid_line	*gl;
 	const struct grid_cell	*gc;
 	struct utf8_data	 ud;
 	u_int		 	 xx, yy, cx, cy, ax, bx;
@@ -304,8 +304,9 @@ screen_write_copy(struct screen_write_ctx *ctx,
 	cx = s->cx;
 	cy = s->cy;
 	for (yy = py; yy < py + ny; yy++) {
-		gl = &gd->linedata[yy];
 		if (yy < gd->hsize + gd->sy) {
+			gl = grid_peek_line(gd, yy);
+
 			/*
 			 * Find start and end position and copy between
 			 * them. Limit to the real end of the line then use a
@@ -325,7 +326,7 @@ screen_write_copy(struct screen_write_ctx *ctx,
 				if (xx >= gl->cellsize)
 					gc = &grid_default_cell;
 				else
-					gc = &gl->celldata[xx];
+					gc = grid_peek_cell(gd, xx, yy);
 				grid_cell_get(gc, &ud);
 				screen_write_cell(ctx, gc);
 			}
@@ -479,12 +480,12 @@ void
 screen_write_backspace(struct screen_write_ctx *ctx)
 {
 	struct screen		*s = ctx->s;
-	struct grid_line	*gl;
+	const struct grid_line	*gl;
 
 	if (s->cx == 0) {
 		if (s->cy == 0)
 			return;
-		gl = &s->grid->linedata[s->grid->hsize + s->cy - 1];
+		gl = grid_peek_line(s->grid, s->grid->hsize + s->cy - 1);
 		if (gl->flags & GRID_LINE_WRAPPED) {
 			s->cy--;
 			s->cx = screen_size_x(s) - 1;
@@ -792,7 +793,7 @@ screen_write_linefeed(struct screen_write_ctx *ctx, int wrapped)
 
 	screen_write_initctx(ctx, &ttyctx, 0);
 
-	gl = &s->grid->linedata[s->grid->hsize + s->cy];
+	gl = grid_get_line(s->grid, s->grid->hsize + s->cy);
 	if (wrapped)
 		gl->flags |= GRID_LINE_WRAPPED;
 
@@ -1001,6 +1002,60 @@ screen_write_cell(struct screen_write_ctx *ctx, const struct grid_cell *gc)
 	}
 }
 
+/* Write a run of ASCII characters with the same attributes. */
+void
+screen_write_cells(struct screen_write_ctx *ctx, const struct grid_cell *gc,
+    const u_char *buf, size_t len)
+{
+	struct screen		*s = ctx->s;
+	struct tty_ctx		 ttyctx;
+	struct grid_cell	 tmp_gc;
+	u_int			 sx = screen_size_x(s), last;
+	size_t			 n;
+
+	last = !(s->mode & MODE_WRAP);
+	while (len > 0) {
+		/* Work out how many will fit before the end of the line. */
+		if (s->cx + last < sx)
+			n = sx - last - s->cx;
+		else
+			n = 0;
+		if (n > len)
+			n = len;
+
+		/*
+		 * Fall back to writing one cell at a time if wrapping or
+		 * inserting, or if the selection might need to be drawn.
+		 */
+		if (n < 2 || (s->mode & MODE_INSERT) || s->sel.flag ||
+		    s->cy > screen_size_y(s) - 1) {
+			memcpy(&tmp_gc, gc, sizeof tmp_gc);
+			grid_cell_one(&tmp_gc, *buf);
+			screen_write_cell(ctx, &tmp_gc);
+
+			buf++;
+			len--;
+			continue;
+		}
+
+		screen_write_initctx(ctx, &ttyctx, 0);
+
+		/* Handle overwriting of UTF-8 characters. */
+		screen_write_overwrite(ctx, n);
+
+		grid_view_set_cells(s->grid, s->cx, s->cy, gc, buf, n);
+		s->cx += n;
+
+		ttyctx.cell = gc;
+		ttyctx.ptr = (void *)buf;
+		ttyctx.num = n;
+		tty_write(tty_cmd_cells, &ttyctx);
+
+		buf += n;
+		len -= n;
+	}
+}
+
 /* Combine a UTF-8 zero-width character onto the previous. */
 int
 screen_write_combine(struct screen_write_ctx *ctx, const struct utf8_data *ud)
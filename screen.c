@@ -215,9 +215,8 @@ screen_resize_y(struct screen *s, u_int sy)
 		s->cy -= needed;
 	}
 
-	/* Resize line arrays. */
-	gd->linedata = xreallocarray(gd->linedata, gd->hsize + sy,
-	    sizeof *gd->linedata);
+	/* Make sure there is space for the lines. */
+	grid_reserve_lines(gd, gd->hsize + sy);
 
 	/* Size increasing. */
 	if (sy > oldy) {
@@ -232,6 +231,7 @@ screen_resize_y(struct screen *s, u_int sy)
 			if (available > needed)
 				available = needed;
 			gd->hsize -= available;
+			grid_uncompact_lines(gd, gd->hsize, available);
 			s->cy += available;
 		} else
 			available = 0;
@@ -239,7 +239,7 @@ screen_resize_y(struct screen *s, u_int sy)
 
 		/* Then fill the rest in with blanks. */
 		for (i = gd->hsize + sy - needed; i < gd->hsize + sy; i++)
-			memset(&gd->linedata[i], 0, sizeof gd->linedata[i]);
+			memset(grid_get_line(gd, i), 0, sizeof *gd->linedata);
 	}
 
 	/* Set the new size, and reset the scroll region. */
@@ -385,12 +385,9 @@ screen_check_selection(struct screen *s, u_int px, u_int py)
 void
 screen_reflow(struct screen *s, u_int new_x)
 {
-	struct grid	*old = s->grid;
-	u_int		 change;
+	u_int	change;
 
-	s->grid = grid_create(old->sx, old->sy, old->hlimit);
-
-	change = grid_reflow(s->grid, old, new_x);
+	change = grid_reflow(s->grid, new_x);
 	if (change < s->cy)
 		s->cy -= change;
 	else
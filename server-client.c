@@ -29,12 +29,21 @@
 
 #include "tmux.h"
 
+/* Value of redraw-interval, updated when it is set. */
+int		redraw_interval;
+
+/* Time the last frame was drawn and timer to wake for the next. */
+struct timeval	server_client_frame_time;
+struct event	server_client_frame_timer;
+
 void	server_client_check_focus(struct window_pane *);
 void	server_client_check_resize(struct window_pane *);
 void	server_client_check_mouse(struct client *, struct window_pane *);
 void	server_client_repeat_timer(int, short, void *);
 void	server_client_check_exit(struct client *);
 void	server_client_check_redraw(struct client *);
+void	server_client_check_dirty(struct client *);
+void	server_client_frame_callback(int, short, void *);
 void	server_client_set_title(struct client *);
 void	server_client_reset_state(struct client *);
 int	server_client_assume_paste(struct session *);
@@ -70,6 +79,8 @@ server_client_create(int fd)
 	c->stdin_data = evbuffer_new();
 	c->stdout_data = evbuffer_new();
 	c->stderr_data = evbuffer_new();
+	ARRAY_INIT(&c->control_panes);
+	ARRAY_INIT(&c->batch_ids);
 
 	c->tty.fd = -1;
 	c->title = NULL;
@@ -80,8 +91,6 @@ server_client_create(int fd)
 	c->tty.sy = 24;
 
 	screen_init(&c->status, c->tty.sx, 1, 0);
-	RB_INIT(&c->status_new);
-	RB_INIT(&c->status_old);
 
 	c->message_string = NULL;
 	ARRAY_INIT(&c->message_log);
@@ -163,8 +172,6 @@ server_client_lost(struct client *c)
 	if (c->stderr_data != c->stdout_data)
 		evbuffer_free(c->stderr_data);
 
-	status_free_jobs(&c->status_new);
-	status_free_jobs(&c->status_old);
 	screen_free(&c->status);
 
 	free(c->title);
@@ -185,6 +192,12 @@ server_client_lost(struct client *c)
 		free(msg->msg);
 	}
 	ARRAY_FREE(&c->message_log);
+	ARRAY_FREE(&c->control_panes);
+	if (c->batch_data != NULL)
+		evbuffer_free(c->batch_data);
+	for (i = 0; i < ARRAY_LENGTH(&c->batch_ids); i++)
+		free(ARRAY_ITEM(&c->batch_ids, i));
+	ARRAY_FREE(&c->batch_ids);
 
 	free(c->prompt_string);
 	free(c->prompt_buffer);
@@ -243,6 +256,8 @@ server_client_callback(int fd, short events, void *data)
 
 	server_push_stdout(c);
 	server_push_stderr(c);
+	if (c->flags & CLIENT_CONTROL)
+		control_check_queued(c);
 
 	server_update_event(c);
 	return;
@@ -284,10 +299,8 @@ server_client_status_timer(void)
 		interval = options_get_number(&s->options, "status-interval");
 
 		difference = tv.tv_sec - c->status_timer.tv_sec;
-		if (interval != 0 && difference >= interval) {
-			status_update_jobs(c);
+		if (interval != 0 && difference >= interval)
 			c->flags |= CLIENT_STATUS;
-		}
 	}
 }
 
@@ -519,7 +532,21 @@ server_client_loop(void)
 	struct client		*c;
 	struct window		*w;
 	struct window_pane	*wp;
+	struct timeval		 tv, now;
 	u_int		 	 i;
+	int			 interval, frame, drawn, dirty;
+
+	/*
+	 * If redrawing is deferred, work out whether it is time for the next
+	 * frame.
+	 */
+	interval = redraw_interval;
+	if (gettimeofday(&now, NULL) != 0)
+		fatal("gettimeofday failed");
+	tv.tv_sec = interval / 1000;
+	tv.tv_usec = (interval % 1000) * 1000L;
+	timeradd(&server_client_frame_time, &tv, &tv);
+	frame = (interval == 0 || !timercmp(&now, &tv, <));
 
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
@@ -529,19 +556,21 @@ server_client_loop(void)
 		server_client_check_exit(c);
 		if (c->session != NULL) {
 			server_client_check_redraw(c);
+			if (frame)
+				server_client_check_dirty(c);
 			server_client_reset_state(c);
 		}
+		if (interval == 0 && c->tty.shadow != NULL)
+			tty_shadow_free(&c->tty);
+		tty_flush(&c->tty);
 	}
 
 	/*
 	 * Any windows will have been redrawn as part of clients, so clear
 	 * their flags now. Also check pane focus and resize.
 	 */
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w == NULL)
-			continue;
-
+	drawn = dirty = 0;
+	RB_FOREACH(w, windows, &windows) {
 		w->flags &= ~WINDOW_REDRAW;
 		TAILQ_FOREACH(wp, &w->panes, entry) {
 			if (wp->fd != -1) {
@@ -549,10 +578,39 @@ server_client_loop(void)
 				server_client_check_resize(wp);
 			}
 			wp->flags &= ~PANE_REDRAW;
+
+			if (wp->flags & PANE_DIRTY) {
+				if (frame) {
+					wp->flags &= ~PANE_DIRTY;
+					drawn = 1;
+				} else
+					dirty = 1;
+			}
+		}
+	}
+
+	/* Start the timer for the next frame if anything is waiting. */
+	if (drawn)
+		memcpy(&server_client_frame_time, &now, sizeof now);
+	if (dirty) {
+		if (!event_initialized(&server_client_frame_timer)) {
+			evtimer_set(&server_client_frame_timer,
+			    server_client_frame_callback, NULL);
+		}
+		if (!evtimer_pending(&server_client_frame_timer, NULL)) {
+			timersub(&tv, &now, &tv);
+			evtimer_add(&server_client_frame_timer, &tv);
 		}
 	}
 }
 
+/* Frame timer callback, nothing to do as the loop draws the frame. */
+void
+server_client_frame_callback(unused int fd, unused short events,
+    unused void *data)
+{
+}
+
 /* Check if pane should be resized. */
 void
 server_client_check_resize(struct window_pane *wp)
@@ -731,6 +789,22 @@ server_client_repeat_timer(unused int fd, unused short events, void *data)
 	}
 }
 
+/*
+ * Count bytes of output waiting for a client: those not yet pushed and those
+ * in frames queued on its socket.
+ */
+size_t
+server_client_queued(struct client *c)
+{
+	struct ibuf	*buf;
+	size_t		 queued;
+
+	queued = EVBUFFER_LENGTH(c->stdout_data);
+	TAILQ_FOREACH(buf, &c->ibuf.w.bufs, entry)
+		queued += buf->wpos - buf->rpos;
+	return (queued);
+}
+
 /* Check if client should be exited. */
 void
 server_client_check_exit(struct client *c)
@@ -744,6 +818,9 @@ server_client_check_exit(struct client *c)
 		return;
 	if (EVBUFFER_LENGTH(c->stderr_data) != 0)
 		return;
+	if (c->batch_data != NULL && (EVBUFFER_LENGTH(c->batch_data) != 0 ||
+	    c->cmdq->item != NULL))
+		return;
 
 	server_write_client(c, MSG_EXIT, &c->retval, sizeof c->retval);
 	c->flags &= ~CLIENT_EXIT;
@@ -802,6 +879,21 @@ server_client_check_redraw(struct client *c)
 	c->flags &= ~(CLIENT_REDRAW|CLIENT_STATUS|CLIENT_BORDERS);
 }
 
+/* Draw any changed lines in the client's panes. */
+void
+server_client_check_dirty(struct client *c)
+{
+	struct window_pane	*wp;
+
+	if (c->flags & (CLIENT_CONTROL|CLIENT_SUSPENDED))
+		return;
+	if (c->tty.term == NULL || c->tty.flags & TTY_FREEZE)
+		return;
+
+	TAILQ_FOREACH(wp, &c->session->curw->window->panes, entry)
+		screen_redraw_dirty(c, wp);
+}
+
 /* Set client title. */
 void
 server_client_set_title(struct client *c)
@@ -996,7 +1088,7 @@ error:
 void
 server_client_msg_identify(struct client *c, struct imsg *imsg)
 {
-	const char	*data;
+	const char	*data, *s;
 	size_t	 	 datalen;
 	int		 flags;
 
@@ -1036,8 +1128,10 @@ server_client_msg_identify(struct client *c, struct imsg *imsg)
 	case MSG_IDENTIFY_ENVIRON:
 		if (datalen == 0 || data[datalen - 1] != '\0')
 			fatalx("bad MSG_IDENTIFY_ENVIRON string");
-		if (strchr(data, '=') != NULL)
-			environ_put(&c->environ, data);
+		for (s = data; s < data + datalen; s += strlen(s) + 1) {
+			if (strchr(s, '=') != NULL)
+				environ_put(&c->environ, s);
+		}
 		break;
 	default:
 		break;
@@ -1058,6 +1152,13 @@ server_client_msg_identify(struct client *c, struct imsg *imsg)
 		evbuffer_free(c->stderr_data);
 		c->stderr_data = c->stdout_data;
 
+		if (c->flags & CLIENT_BATCH) {
+			c->stdin_callback = control_batch_callback;
+			c->batch_data = evbuffer_new();
+			c->cmdq->client_exit = 0;
+			c->cmdq->itemfn = control_batch_done;
+		}
+
 		if (c->flags & CLIENT_CONTROLCONTROL)
 			evbuffer_add_printf(c->stdout_data, "\033P1000p");
 		server_write_client(c, MSG_STDIN, NULL, 0);
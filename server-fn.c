@@ -537,48 +537,46 @@ server_update_event(struct client *c)
 	event_add(&c->event, NULL);
 }
 
+/*
+ * Push data to client if possible. It is sent in frames as large as imsg
+ * allows, and several are queued at once so a big buffer goes out in a few
+ * loop iterations.
+ */
+void
+server_push_data(struct client *c, enum msgtype type, struct evbuffer *evb)
+{
+	size_t	size;
+
+	while ((size = EVBUFFER_LENGTH(evb)) != 0) {
+		if (c->ibuf.w.queued >= SERVER_PUSH_FRAMES)
+			break;
+		if (size > MAX_IMSGSIZE - IMSG_HEADER_SIZE)
+			size = MAX_IMSGSIZE - IMSG_HEADER_SIZE;
+		if (server_write_client(c, type, EVBUFFER_DATA(evb), size) != 0)
+			break;
+		evbuffer_drain(evb, size);
+	}
+}
+
 /* Push stdout to client if possible. */
 void
 server_push_stdout(struct client *c)
 {
-	struct msg_stdout_data data;
-	size_t                 size;
-
-	size = EVBUFFER_LENGTH(c->stdout_data);
-	if (size == 0)
-		return;
-	if (size > sizeof data.data)
-		size = sizeof data.data;
-
-	memcpy(data.data, EVBUFFER_DATA(c->stdout_data), size);
-	data.size = size;
-
-	if (server_write_client(c, MSG_STDOUT, &data, sizeof data) == 0)
-		evbuffer_drain(c->stdout_data, size);
+	if (c->batch_data != NULL)
+		server_push_data(c, MSG_STDOUT, c->batch_data);
+	else
+		server_push_data(c, MSG_STDOUT, c->stdout_data);
 }
 
 /* Push stderr to client if possible. */
 void
 server_push_stderr(struct client *c)
 {
-	struct msg_stderr_data data;
-	size_t                 size;
-
 	if (c->stderr_data == c->stdout_data) {
 		server_push_stdout(c);
 		return;
 	}
-	size = EVBUFFER_LENGTH(c->stderr_data);
-	if (size == 0)
-		return;
-	if (size > sizeof data.data)
-		size = sizeof data.data;
-
-	memcpy(data.data, EVBUFFER_DATA(c->stderr_data), size);
-	data.size = size;
-
-	if (server_write_client(c, MSG_STDERR, &data, sizeof data) == 0)
-		evbuffer_drain(c->stderr_data, size);
+	server_push_data(c, MSG_STDERR, c->stderr_data);
 }
 
 /* Set stdin callback. */
@@ -29,28 +29,65 @@ int	server_window_check_activity(struct session *, struct winlink *);
 int	server_window_check_silence(struct session *, struct winlink *);
 void	ring_bell(struct session *);
 
-/* Window functions that need to happen every loop. */
+/*
+ * Windows whose alert flags may need to be acted on. Windows are queued when a
+ * pane has output, when they become or stop being the current window and once
+ * a second while they have any alert flags set.
+ */
+TAILQ_HEAD(, window) server_window_alerts =
+    TAILQ_HEAD_INITIALIZER(server_window_alerts);
+
+/* Number of loops and of windows checked, shown by server-info. */
+u_int	server_window_loops;
+u_int	server_window_checks;
+
+/* Queue a window to have its alerts checked at the end of this loop. */
+void
+server_window_queue_alerts(struct window *w)
+{
+	if (w->flags & WINDOW_ALERTQUEUED)
+		return;
+	w->flags |= WINDOW_ALERTQUEUED;
+	TAILQ_INSERT_TAIL(&server_window_alerts, w, alerts_entry);
+}
+
+void
+server_window_unqueue_alerts(struct window *w)
+{
+	if (~w->flags & WINDOW_ALERTQUEUED)
+		return;
+	w->flags &= ~WINDOW_ALERTQUEUED;
+	TAILQ_REMOVE(&server_window_alerts, w, alerts_entry);
+}
+
+/* Check alerts for each session containing the queued windows. */
 void
 server_window_loop(void)
 {
 	struct window	*w;
 	struct winlink	*wl;
 	struct session	*s;
-	u_int		 i;
+	int		 alerts;
+
+	server_window_loops++;
+
+	while ((w = TAILQ_FIRST(&server_window_alerts)) != NULL) {
+		server_window_unqueue_alerts(w);
+		server_window_checks++;
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w == NULL)
+		if (!(w->flags & WINDOW_ALERTFLAGS))
 			continue;
 
-		RB_FOREACH(s, sessions, &sessions) {
-			wl = session_has(s, w);
-			if (wl == NULL)
+		TAILQ_FOREACH(wl, &w->winlinks, wentry) {
+			s = wl->session;
+			if (session_has(s, w) != wl)
 				continue;
 
-			if (server_window_check_bell(s, wl) ||
-			    server_window_check_activity(s, wl) ||
-			    server_window_check_silence(s, wl))
+			/* Check all three as the window will not be rechecked. */
+			alerts = server_window_check_bell(s, wl);
+			alerts |= server_window_check_activity(s, wl);
+			alerts |= server_window_check_silence(s, wl);
+			if (alerts)
 				server_status_session(s);
 		}
 	}
@@ -94,6 +94,7 @@ session_create(const char *name, int argc, char **argv, const char *path,
 	s = xmalloc(sizeof *s);
 	s->references = 0;
 	s->flags = 0;
+	s->group = NULL;
 
 	if (gettimeofday(&s->creation_time, NULL) != 0)
 		fatal("gettimeofday failed");
@@ -241,6 +242,7 @@ session_new(struct session *s, const char *name, int argc, char **argv,
 		xasprintf(cause, "index in use: %d", idx);
 		return (NULL);
 	}
+	wl->session = s;
 
 	environ_init(&env);
 	environ_copy(&global_environ, &env);
@@ -280,6 +282,7 @@ session_attach(struct session *s, struct window *w, int idx, char **cause)
 		xasprintf(cause, "index in use: %d", idx);
 		return (NULL);
 	}
+	wl->session = s;
 	winlink_set_window(wl, w);
 	notify_window_linked(s, w);
 
@@ -311,13 +314,7 @@ session_detach(struct session *s, struct winlink *wl)
 struct winlink *
 session_has(struct session *s, struct window *w)
 {
-	struct winlink	*wl;
-
-	RB_FOREACH(wl, winlinks, &s->windows) {
-		if (wl->window == w)
-			return (wl);
-	}
-	return (NULL);
+	return (winlink_find_by_window(&s->windows, w));
 }
 
 struct winlink *
@@ -418,8 +415,11 @@ session_set_current(struct session *s, struct winlink *wl)
 
 	winlink_stack_remove(&s->lastw, wl);
 	winlink_stack_push(&s->lastw, s->curw);
+	if (s->curw != NULL)
+		server_window_queue_alerts(s->curw->window);
 	s->curw = wl;
 	winlink_clear_flags(wl);
+	server_window_queue_alerts(wl->window);
 	return (0);
 }
 
@@ -427,16 +427,7 @@ session_set_current(struct session *s, struct winlink *wl)
 struct session_group *
 session_group_find(struct session *target)
 {
-	struct session_group	*sg;
-	struct session		*s;
-
-	TAILQ_FOREACH(sg, &session_groups, entry) {
-		TAILQ_FOREACH(s, &sg->sessions, gentry) {
-			if (s == target)
-				return (sg);
-		}
-	}
-	return (NULL);
+	return (target->group);
 }
 
 /* Find session group index. */
@@ -470,8 +461,10 @@ session_group_add(struct session *target, struct session *s)
 		TAILQ_INSERT_TAIL(&session_groups, sg, entry);
 		TAILQ_INIT(&sg->sessions);
 		TAILQ_INSERT_TAIL(&sg->sessions, target, gentry);
+		target->group = sg;
 	}
 	TAILQ_INSERT_TAIL(&sg->sessions, s, gentry);
+	s->group = sg;
 }
 
 /* Remove a session from its group and destroy the group if empty. */
@@ -483,8 +476,12 @@ session_group_remove(struct session *s)
 	if ((sg = session_group_find(s)) == NULL)
 		return;
 	TAILQ_REMOVE(&sg->sessions, s, gentry);
-	if (TAILQ_NEXT(TAILQ_FIRST(&sg->sessions), gentry) == NULL)
-		TAILQ_REMOVE(&sg->sessions, TAILQ_FIRST(&sg->sessions), gentry);
+	s->group = NULL;
+	if (TAILQ_NEXT(TAILQ_FIRST(&sg->sessions), gentry) == NULL) {
+		s = TAILQ_FIRST(&sg->sessions);
+		TAILQ_REMOVE(&sg->sessions, s, gentry);
+		s->group = NULL;
+	}
 	if (TAILQ_EMPTY(&sg->sessions)) {
 		TAILQ_REMOVE(&session_groups, sg, entry);
 		free(sg);
@@ -568,6 +565,7 @@ session_group_synchronize1(struct session *target, struct session *s)
 	/* Link all the windows from the target. */
 	RB_FOREACH(wl, winlinks, ww) {
 		wl2 = winlink_add(&s->windows, wl->idx);
+		wl2->session = s;
 		winlink_set_window(wl2, wl->window);
 		notify_window_linked(s, wl2->window);
 		wl2->flags |= wl->flags & WINLINK_ALERTFLAGS;
@@ -618,6 +616,7 @@ session_renumber_windows(struct session *s)
 	/* Go through the winlinks and assign new indexes. */
 	RB_FOREACH(wl, winlinks, &old_wins) {
 		wl_new = winlink_add(&s->windows, new_idx);
+		wl_new->session = s;
 		winlink_set_window(wl_new, wl->window);
 		wl_new->flags |= wl->flags & WINLINK_ALERTFLAGS;
 
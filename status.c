@@ -34,6 +34,7 @@ char   *status_redraw_get_left(struct client *, time_t, int, struct grid_cell *,
 char   *status_redraw_get_right(struct client *, time_t, int,
 	    struct grid_cell *, size_t *);
 char   *status_find_job(struct client *, char **);
+void	status_tidy_jobs(time_t);
 void	status_job_free(void *);
 void	status_job_callback(struct job *);
 char   *status_print(struct client *, struct winlink *, time_t,
@@ -50,8 +51,12 @@ char   *status_prompt_complete(const char *);
 /* Status prompt history. */
 ARRAY_DECL(, char *) status_prompt_history = ARRAY_INITIALIZER;
 
-/* Status output tree. */
+/*
+ * Status output tree. This is shared by all clients so each command is run
+ * only once, however many clients show it.
+ */
 RB_GENERATE(status_out_tree, status_out, entry, status_out_cmp);
+struct status_out_tree status_jobs = RB_INITIALIZER(status_jobs);
 
 /* Output tree comparison function. */
 int
@@ -353,6 +358,7 @@ draw:
 out:
 	free(left);
 	free(right);
+	c->flags &= ~CLIENT_STATUSFORCE;
 
 	if (grid_compare(c->status.grid, old_status.grid) == 0) {
 		screen_free(&old_status);
@@ -475,6 +481,8 @@ status_find_job(struct client *c, char **iptr)
 	char   			*cmd;
 	int			 lastesc;
 	size_t			 len;
+	time_t			 t;
+	int			 interval;
 
 	if (**iptr == '\0')
 		return (NULL);
@@ -504,89 +512,78 @@ status_find_job(struct client *c, char **iptr)
 	(*iptr)++;			/* skip final ) */
 	cmd[len] = '\0';
 
-	/* First try in the new tree. */
+	/* Find the output, adding it to the tree if it isn't there. */
+	t = time(NULL);
 	so_find.cmd = cmd;
-	so = RB_FIND(status_out_tree, &c->status_new, &so_find);
-	if (so != NULL && so->out != NULL) {
-		free(cmd);
-		return (so->out);
-	}
-
-	/* If not found at all, start the job and add to the tree. */
+	so = RB_FIND(status_out_tree, &status_jobs, &so_find);
 	if (so == NULL) {
-		job_run(cmd, NULL, status_job_callback, status_job_free, c);
-		c->references++;
+		status_tidy_jobs(t);
 
-		so = xmalloc(sizeof *so);
-		so->cmd = xstrdup(cmd);
-		so->out = NULL;
-		RB_INSERT(status_out_tree, &c->status_new, so);
+		so = xcalloc(1, sizeof *so);
+		so->cmd = cmd;
+		RB_INSERT(status_out_tree, &status_jobs, so);
+	} else
+		free(cmd);
+	so->used = t;
+
+	/*
+	 * Start the job if it has not run yet, if its output is older than
+	 * the status interval or if the client has asked for it to be
+	 * refreshed. Only one job is run at a time for each command.
+	 */
+	interval = options_get_number(&c->session->options, "status-interval");
+	if (so->job == NULL && (so->last == 0 ||
+	    (interval != 0 && t - so->last >= interval) ||
+	    (c->flags & CLIENT_STATUSFORCE))) {
+		so->job = job_run(so->cmd, NULL, status_job_callback,
+		    status_job_free, so);
+		so->last = t;
 	}
 
-	/* Lookup in the old tree. */
-	so_find.cmd = cmd;
-	so = RB_FIND(status_out_tree, &c->status_old, &so_find);
-	free(cmd);
-	if (so != NULL)
-		return (so->out);
-	return (NULL);
+	return (so->out);
 }
 
-/* Free job tree. */
+/* Remove jobs which have not been used for an hour. */
 void
-status_free_jobs(struct status_out_tree *sotree)
+status_tidy_jobs(time_t t)
 {
-	struct status_out	*so, *so_next;
+	struct status_out	*so, *so1;
 
-	so_next = RB_MIN(status_out_tree, sotree);
-	while (so_next != NULL) {
-		so = so_next;
-		so_next = RB_NEXT(status_out_tree, sotree, so);
-
-		RB_REMOVE(status_out_tree, sotree, so);
+	RB_FOREACH_SAFE(so, status_out_tree, &status_jobs, so1) {
+		if (so->job != NULL || t - so->used < 3600)
+			continue;
+		RB_REMOVE(status_out_tree, &status_jobs, so);
 		free(so->out);
 		free(so->cmd);
 		free(so);
 	}
 }
 
-/* Update jobs on status interval. */
+/* Force jobs to be run again on the next redraw of this client. */
 void
 status_update_jobs(struct client *c)
 {
-	/* Free the old tree. */
-	status_free_jobs(&c->status_old);
-
-	/* Move the new to old. */
-	memcpy(&c->status_old, &c->status_new, sizeof c->status_old);
-	RB_INIT(&c->status_new);
+	c->flags |= CLIENT_STATUSFORCE;
 }
 
 /* Free status job. */
 void
 status_job_free(void *data)
 {
-	struct client	*c = data;
+	struct status_out	*so = data;
 
-	c->references--;
+	so->job = NULL;
 }
 
-/* Job has finished: save its result. */
+/* Job has finished: save its result and redraw clients if it has changed. */
 void
 status_job_callback(struct job *job)
 {
-	struct client		*c = job->data;
-	struct status_out	*so, so_find;
+	struct status_out	*so = job->data;
+	struct client		*c;
 	char			*line, *buf;
 	size_t			 len;
-
-	if (c->flags & CLIENT_DEAD)
-		return;
-
-	so_find.cmd = job->cmd;
-	so = RB_FIND(status_out_tree, &c->status_new, &so_find);
-	if (so == NULL || so->out != NULL)
-		return;
+	u_int			 i;
 
 	buf = NULL;
 	if ((line = evbuffer_readline(job->event->input)) == NULL) {
@@ -598,8 +595,18 @@ status_job_callback(struct job *job)
 	} else
 		buf = line;
 
+	if (so->out != NULL && strcmp(so->out, buf) == 0) {
+		free(buf);
+		return;
+	}
+	free(so->out);
 	so->out = buf;
-	server_status_client(c);
+
+	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
+		c = ARRAY_ITEM(&clients, i);
+		if (c != NULL && c->session != NULL)
+			server_status_client(c);
+	}
 }
 
 /* Return winlink status line entry and adjust gc as necessary. */
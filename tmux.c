@@ -18,6 +18,9 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#if !defined(HAVE_CLOSEFROM) && defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 #include <errno.h>
 #include <event.h>
@@ -46,6 +49,8 @@ char		*cfg_file;
 char		*shell_cmd;
 int		 debug_level;
 time_t		 start_time;
+u_int		 osdep_cache_hits;
+u_int		 osdep_cache_misses;
 char		 socket_path[PATH_MAX];
 int		 login_shell;
 char		*environ_path;
@@ -61,7 +66,7 @@ __dead void
 usage(void)
 {
 	fprintf(stderr,
-	    "usage: %s [-2lquvV] [-c shell-command] [-f file] [-L socket-name]\n"
+	    "usage: %s [-2BlquvV] [-c shell-command] [-f file] [-L socket-name]\n"
 	    "            [-S socket-path] [command [flags]]\n",
 	    __progname);
 	exit(1);
@@ -175,6 +180,27 @@ setblocking(int fd, int state)
 	}
 }
 
+/*
+ * Close descriptors from fd up in a child started with vfork, which may only
+ * make system calls. The compat closefrom reads /proc/<pid>/fd and so
+ * allocates, so without a native closefrom try close_range and otherwise
+ * close every descriptor below maxfd, which the parent gets before vfork.
+ */
+void
+closefrom_vfork(int fd, unused int maxfd)
+{
+#ifdef HAVE_CLOSEFROM
+	closefrom(fd);
+#else
+#if defined(__linux__) && defined(SYS_close_range)
+	if (syscall(SYS_close_range, fd, ~0U, 0) == 0)
+		return;
+#endif
+	for (; fd < maxfd; fd++)
+		close(fd);
+#endif
+}
+
 __dead void
 shell_exec(const char *shell, const char *shellcmd)
 {
@@ -220,11 +246,14 @@ main(int argc, char **argv)
 	flags = 0;
 	label = path = NULL;
 	login_shell = (**argv == '-');
-	while ((opt = getopt(argc, argv, "2c:Cdf:lL:qS:uUVv")) != -1) {
+	while ((opt = getopt(argc, argv, "2Bc:Cdf:lL:qS:uUVv")) != -1) {
 		switch (opt) {
 		case '2':
 			flags |= CLIENT_256COLOURS;
 			break;
+		case 'B':
+			flags |= CLIENT_CONTROL|CLIENT_BATCH;
+			break;
 		case 'c':
 			free(shell_cmd);
 			shell_cmd = xstrdup(optarg);
@@ -268,7 +297,7 @@ main(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
-	if (shell_cmd != NULL && argc != 0)
+	if ((shell_cmd != NULL || (flags & CLIENT_BATCH)) && argc != 0)
 		usage();
 
 	if (!(flags & CLIENT_UTF8)) {
@@ -19,7 +19,7 @@
 #ifndef TMUX_H
 #define TMUX_H
 
-#define PROTOCOL_VERSION 8
+#define PROTOCOL_VERSION 10
 
 #include <sys/time.h>
 #include <sys/uio.h>
@@ -53,6 +53,17 @@ extern char   **environ;
 /* Automatic name refresh interval, in milliseconds. */
 #define NAME_INTERVAL 500
 
+/*
+ * Number of times a window name is checked again, once a second, after
+ * output, and the longest time in seconds between checks otherwise. These
+ * catch processes which exec without changing process group.
+ */
+#define NAME_CHECKS 3
+#define NAME_RECHECK 10
+
+/* Maximum number of stdout or stderr frames queued to a client at once. */
+#define SERVER_PUSH_FRAMES 16
+
 /*
  * UTF-8 data size. This must be big enough to hold combined characters as well
  * as single.
@@ -424,15 +435,7 @@ struct msg_stdin_data {
 	char	data[BUFSIZ];
 };
 
-struct msg_stdout_data {
-	ssize_t	size;
-	char	data[BUFSIZ];
-};
-
-struct msg_stderr_data {
-	ssize_t	size;
-	char	data[BUFSIZ];
-};
+/* MSG_STDOUT and MSG_STDERR are followed by up to MAX_IMSGSIZE of data. */
 
 /* Mode key commands. */
 enum mode_key_cmd {
@@ -634,9 +637,18 @@ struct utf8_data {
 #define GRID_FLAG_FG256 0x1
 #define GRID_FLAG_BG256 0x2
 #define GRID_FLAG_PADDING 0x4
+#define GRID_FLAG_EXTENDED 0x8 /* compact entries only */
 
 /* Grid line flags. */
 #define GRID_LINE_WRAPPED 0x1
+#define GRID_LINE_COMPACT 0x2
+#define GRID_LINE_COLD 0x4
+
+/* Number of history lines compressed together into a block. */
+#define GRID_BLOCK_LINES 128
+
+/* Unused space allowed in a history spill file before it is compacted. */
+#define GRID_SPILL_SLACK (1024 * 1024)
 
 /* Grid cell data. */
 struct grid_cell {
@@ -649,11 +661,56 @@ struct grid_cell {
 	u_char	xdata[UTF8_SIZE];
 } __packed;
 
+/*
+ * Compact grid cell, used for lines in the history. A cell with a single
+ * byte of data and width one is stored inline; anything else is stored in
+ * full in the line's extended cells and the entry holds its offset.
+ */
+struct grid_cell_entry {
+	u_char	flags;
+	union {
+		u_int	offset;
+		struct {
+			u_char	attr;
+			u_char	fg;
+			u_char	bg;
+			u_char	data;
+		} data;
+	};
+} __packed;
+
+/*
+ * Compressed block of cold history lines. The compact entries of all the
+ * lines are stored as five planes (one for each byte of the entry) followed
+ * by the extended cells, and the whole is run-length encoded. If the block
+ * has been spilled to disk, data is NULL and offset is its position in the
+ * grid's spill file.
+ */
+struct grid_block {
+	u_char	*data;
+	size_t	 size;
+	off_t	 offset;
+
+	u_int	 cells;
+	u_int	 extdsize;
+
+	u_int	 references;
+
+	TAILQ_ENTRY(grid_block) entry;
+};
+
 /* Grid line. */
 struct grid_line {
 	u_int	cellsize;
 	struct grid_cell *celldata;
 
+	struct grid_cell_entry *compactdata;
+	u_int	extdsize;
+	struct grid_cell *extddata;
+
+	struct grid_block *block;
+	u_int	blockoffset;
+
 	int	flags;
 } __packed;
 
@@ -661,6 +718,7 @@ struct grid_line {
 struct grid {
 	int	flags;
 #define GRID_HISTORY 0x1	/* scroll lines into history */
+#define GRID_NOSPILL 0x2	/* spill file failed, keep history in memory */
 
 	u_int	sx;
 	u_int	sy;
@@ -669,6 +727,34 @@ struct grid {
 	u_int	hlimit;
 
 	struct grid_line *linedata;
+	u_int	linesize;
+	u_int	lineoffset;
+
+	/* History lines at the top not yet reflowed to the current width. */
+	u_int	hreflow;
+
+	/* Last compact line decoded by grid_peek_cell. */
+	const void *decodedline;
+	struct grid_cell *decodeddata;
+	u_int	decodedsize;
+
+	/* Compressed history and the last block expanded. */
+	u_int	hfrozen;
+	u_int	coldsize;
+	size_t	coldbytes;
+
+	struct grid_block *thawedblock;
+	u_char	*thaweddata;
+	size_t	thawedsize;
+
+	/* History spilled to disk, oldest block first. */
+	int	spillfd;
+	u_int	hspilled;
+	size_t	spillsize;
+	size_t	spilllive;
+	u_char	*spillmap;
+	size_t	spillmapsize;
+	TAILQ_HEAD(, grid_block) spilled;
 };
 
 /* Option data structures. */
@@ -887,6 +973,10 @@ struct window_pane {
 #define PANE_RESIZE 0x8
 #define PANE_FOCUSPUSH 0x10
 #define PANE_INPUTOFF 0x20
+#define PANE_DIRTY 0x40
+
+	u_int		 dirty_upper;
+	u_int		 dirty_lower;
 
 	int		 argc;
 	char	       **argv;
@@ -929,13 +1019,45 @@ TAILQ_HEAD(window_panes, window_pane);
 RB_HEAD(window_pane_tree, window_pane);
 ARRAY_DECL(window_pane_list, struct window_pane *);
 
+/*
+ * Map of the pane and border type of each cell in a window, built when the
+ * panes are moved or resized.
+ */
+struct window_map {
+	u_int		 wsx;
+	u_int		 wsy;
+
+	u_int		 sx;
+	u_int		 sy;
+
+	struct window_map_pane {
+		struct window_pane *wp;
+		u_int		 xoff;
+		u_int		 yoff;
+		u_int		 sx;
+		u_int		 sy;
+		int		 visible;
+	}		*panes;
+	u_int		 npanes;
+
+	u_char		*type;
+	u_short		*pane;
+	u_short		*at;
+};
+
 /* Window structure. */
 struct window {
 	u_int		 id;
 	char		*name;
-	struct event	 name_timer;
 	struct timeval   silence_timer;
 
+	u_int		 name_pane;	/* active pane at last name check */
+	pid_t		 name_pgrp;	/* and its foreground process group */
+	u_int		 name_checks;	/* checks left after output stops */
+	time_t		 name_time;	/* time of last name check */
+	TAILQ_ENTRY(window) name_entry;
+	TAILQ_ENTRY(window) alerts_entry;
+
 	struct window_pane *active;
 	struct window_pane *last;
 	struct window_panes panes;
@@ -943,6 +1065,7 @@ struct window {
 	int		 lastlayout;
 	struct layout_cell *layout_root;
 	struct layout_cell *saved_layout_root;
+	struct window_map *map;
 
 	u_int		 sx;
 	u_int		 sy;
@@ -952,6 +1075,8 @@ struct window {
 #define WINDOW_ACTIVITY 0x2
 #define WINDOW_REDRAW 0x4
 #define WINDOW_SILENCE 0x8
+#define WINDOW_NAMEQUEUED 0x10
+#define WINDOW_ALERTQUEUED 0x20
 #define WINDOW_ZOOMED 0x1000
 #define WINDOW_FORCEWIDTH 0x2000
 #define WINDOW_FORCEHEIGHT 0x4000
@@ -960,12 +1085,16 @@ struct window {
 	struct options	 options;
 
 	u_int		 references;
+
+	TAILQ_HEAD(, winlink) winlinks;
+	RB_ENTRY(window) entry;
 };
-ARRAY_DECL(windows, struct window *);
+RB_HEAD(windows, window);
 
 /* Entry on local window list. */
 struct winlink {
 	int		 idx;
+	struct session	*session;
 	struct window	*window;
 
 	size_t		 status_width;
@@ -980,6 +1109,7 @@ struct winlink {
 
 	RB_ENTRY(winlink) entry;
 	TAILQ_ENTRY(winlink) sentry;
+	TAILQ_ENTRY(winlink) wentry;
 };
 RB_HEAD(winlinks, winlink);
 TAILQ_HEAD(winlink_stack, winlink);
@@ -1072,6 +1202,7 @@ struct session {
 
 	int		 references;
 
+	struct session_group *group;
 	TAILQ_ENTRY(session) gentry;
 	RB_ENTRY(session)    entry;
 };
@@ -1190,6 +1321,16 @@ struct tty {
 	int		 fd;
 	struct bufferevent *event;
 
+	u_char		*obuf;
+	size_t		 obuflen;
+
+	struct grid_cell *shadow;
+	u_int		 shadowsx;
+	u_int		 shadowsy;
+
+	u_long		 written;
+	u_long		 flushes;
+
 	int		 log_fd;
 
 	struct termios	 tio;
@@ -1247,10 +1388,14 @@ struct message_entry {
 	time_t	msg_time;
 };
 
-/* Status output data from a job. */
+/* Status output data from a job, shared by all clients. */
 struct status_out {
-	char   *cmd;
-	char   *out;
+	char		*cmd;
+	char		*out;
+
+	struct job	*job;
+	time_t		 last;
+	time_t		 used;
 
 	RB_ENTRY(status_out) entry;
 };
@@ -1283,10 +1428,14 @@ struct client {
 	struct evbuffer	*stdout_data;
 	struct evbuffer	*stderr_data;
 
+	size_t		 control_dropped;
+	ARRAY_DECL(, u_int) control_panes;
+
+	struct evbuffer	*batch_data;
+	ARRAY_DECL(, char *) batch_ids;
+
 	struct event	 repeat_timer;
 
-	struct status_out_tree status_old;
-	struct status_out_tree status_new;
 	struct timeval	 status_timer;
 	struct screen	 status;
 
@@ -1309,6 +1458,9 @@ struct client {
 #define CLIENT_UTF8 0x10000
 #define CLIENT_256COLOURS 0x20000
 #define CLIENT_IDENTIFIED 0x40000
+#define CLIENT_STATUSFORCE 0x80000
+#define CLIENT_CONTROLPAUSED 0x100000
+#define CLIENT_BATCH 0x200000
 	int		 flags;
 	struct key_table *keytable;
 
@@ -1384,6 +1536,7 @@ enum cmd_retval {
 /* Command queue entry. */
 struct cmd_q_item {
 	struct cmd_list		*cmdlist;
+	int			 error;
 	TAILQ_ENTRY(cmd_q_item)	 qentry;
 };
 TAILQ_HEAD(cmd_q_items, cmd_q_item);
@@ -1404,6 +1557,7 @@ struct cmd_q {
 	u_int			 number;
 
 	void			 (*emptyfn)(struct cmd_q *);
+	void			 (*itemfn)(struct cmd_q *, int);
 	void			*data;
 
 	TAILQ_ENTRY(cmd_q)       waitentry;
@@ -1423,6 +1577,7 @@ struct cmd_entry {
 #define CMD_STARTSERVER 0x1
 #define CMD_CANTNEST 0x2
 #define CMD_READONLY 0x4
+#define CMD_ENVIRON 0x8
 	int		 flags;
 
 	enum cmd_retval	 (*exec)(struct cmd *, struct cmd_q *);
@@ -1498,6 +1653,8 @@ extern char	*cfg_file;
 extern char	*shell_cmd;
 extern int	 debug_level;
 extern time_t	 start_time;
+extern u_int	 osdep_cache_hits;
+extern u_int	 osdep_cache_misses;
 extern char	 socket_path[PATH_MAX];
 extern int	 login_shell;
 extern char	*environ_path;
@@ -1506,6 +1663,7 @@ const char	*getshell(void);
 int		 checkshell(const char *);
 int		 areshell(const char *);
 void		 setblocking(int, int);
+void		 closefrom_vfork(int, int);
 __dead void	 shell_exec(const char *, const char *);
 
 /* cfg.c */
@@ -1615,7 +1773,8 @@ void	environ_set(struct environ *, const char *, const char *);
 void	environ_put(struct environ *, const char *);
 void	environ_unset(struct environ *, const char *);
 void	environ_update(const char *, struct environ *, struct environ *);
-void	environ_push(struct environ *);
+char  **environ_array(struct environ *);
+void	environ_free_array(char **);
 
 /* tty.c */
 void	tty_init_termios(int, struct termios *, struct bufferevent *);
@@ -1635,6 +1794,7 @@ void	tty_putcode_ptr2(struct tty *, enum tty_code_code, const void *,
 void	tty_puts(struct tty *, const char *);
 void	tty_putc(struct tty *, u_char);
 void	tty_putn(struct tty *, const void *, size_t, u_int);
+void	tty_flush(struct tty *);
 void	tty_init(struct tty *, struct client *, int, char *);
 int	tty_resize(struct tty *);
 int	tty_set_size(struct tty *, u_int, u_int);
@@ -1645,6 +1805,8 @@ void	tty_set_title(struct tty *, const char *);
 void	tty_update_mode(struct tty *, int, struct screen *);
 void	tty_force_cursor_colour(struct tty *, const char *);
 void	tty_draw_line(struct tty *, struct screen *, u_int, u_int, u_int);
+void	tty_draw_line_diff(struct tty *, struct screen *, u_int, u_int, u_int);
+void	tty_shadow_free(struct tty *);
 int	tty_open(struct tty *, char **);
 void	tty_close(struct tty *);
 void	tty_free(struct tty *);
@@ -1652,6 +1814,7 @@ void	tty_write(
 	    void (*)(struct tty *, const struct tty_ctx *), struct tty_ctx *);
 void	tty_cmd_alignmenttest(struct tty *, const struct tty_ctx *);
 void	tty_cmd_cell(struct tty *, const struct tty_ctx *);
+void	tty_cmd_cells(struct tty *, const struct tty_ctx *);
 void	tty_cmd_clearendofline(struct tty *, const struct tty_ctx *);
 void	tty_cmd_clearendofscreen(struct tty *, const struct tty_ctx *);
 void	tty_cmd_clearline(struct tty *, const struct tty_ctx *);
@@ -1887,6 +2050,7 @@ void	 server_update_socket(void);
 void	 server_add_accept(int);
 
 /* server-client.c */
+extern int redraw_interval;
 void	 server_client_handle_key(struct client *, int);
 void	 server_client_create(int);
 int      server_client_open(struct client *, char **);
@@ -1894,9 +2058,14 @@ void	 server_client_lost(struct client *);
 void	 server_client_callback(int, short, void *);
 void	 server_client_status_timer(void);
 void	 server_client_loop(void);
+size_t	 server_client_queued(struct client *);
 
 /* server-window.c */
+extern u_int server_window_loops;
+extern u_int server_window_checks;
 void	 server_window_loop(void);
+void	 server_window_queue_alerts(struct window *);
+void	 server_window_unqueue_alerts(struct window *);
 
 /* server-fn.c */
 void	 server_fill_environ(struct session *, struct environ *);
@@ -1930,6 +2099,7 @@ void	 server_check_unattached(void);
 void	 server_set_identify(struct client *);
 void	 server_clear_identify(struct client *);
 void	 server_update_event(struct client *);
+void	 server_push_data(struct client *, enum msgtype, struct evbuffer *);
 void	 server_push_stdout(struct client *);
 void	 server_push_stderr(struct client *);
 int	 server_set_stdin_callback(struct client *, void (*)(struct client *,
@@ -1940,7 +2110,6 @@ void	 server_unzoom_window(struct window *);
 int	 status_out_cmp(struct status_out *, struct status_out *);
 RB_PROTOTYPE(status_out_tree, status_out, entry, status_out_cmp);
 int	 status_at_line(struct client *);
-void	 status_free_jobs(struct status_out_tree *);
 void	 status_update_jobs(struct client *);
 void	 status_set_window_at(struct client *, u_int);
 int	 status_redraw(struct client *);
@@ -1958,6 +2127,7 @@ void	 status_prompt_update(struct client *, const char *, const char *);
 void	 recalculate_sizes(void);
 
 /* input.c */
+void	 input_build(void);
 void	 input_init(struct window_pane *);
 void	 input_free(struct window_pane *);
 void	 input_parse(struct window_pane *);
@@ -1988,14 +2158,22 @@ extern const struct grid_cell grid_marker_cell;
 struct grid *grid_create(u_int, u_int, u_int);
 void	 grid_destroy(struct grid *);
 int	 grid_compare(struct grid *, struct grid *);
+struct grid_line *grid_get_line(struct grid *, u_int);
+void	 grid_reserve_lines(struct grid *, u_int);
 void	 grid_collect_history(struct grid *);
+void	 grid_clear_history(struct grid *);
 void	 grid_scroll_history(struct grid *);
 void	 grid_scroll_history_region(struct grid *, u_int, u_int);
 void	 grid_expand_line(struct grid *, u_int, u_int);
+void	 grid_uncompact_lines(struct grid *, u_int, u_int);
+void	 grid_freeze_history(struct grid *, u_int, u_int);
+unsigned long long grid_history_bytes(struct grid *);
 const struct grid_cell *grid_peek_cell(struct grid *, u_int, u_int);
 const struct grid_line *grid_peek_line(struct grid *, u_int);
 struct grid_cell *grid_get_cell(struct grid *, u_int, u_int);
 void	 grid_set_cell(struct grid *, u_int, u_int, const struct grid_cell *);
+void	 grid_set_cells(struct grid *, u_int, u_int, const struct grid_cell *,
+	     const u_char *, size_t);
 void	 grid_clear(struct grid *, u_int, u_int, u_int, u_int);
 void	 grid_clear_lines(struct grid *, u_int, u_int);
 void	 grid_move_lines(struct grid *, u_int, u_int, u_int);
@@ -2004,7 +2182,8 @@ char	*grid_string_cells(struct grid *, u_int, u_int, u_int,
 	     struct grid_cell **, int, int, int);
 void	 grid_duplicate_lines(
 	     struct grid *, u_int, struct grid *, u_int, u_int);
-u_int	 grid_reflow(struct grid *, struct grid *, u_int);
+u_int	 grid_reflow(struct grid *, u_int);
+void	 grid_reflow_history(struct grid *);
 
 /* grid-cell.c */
 u_int	 grid_cell_width(const struct grid_cell *);
@@ -2017,6 +2196,8 @@ const struct grid_cell *grid_view_peek_cell(struct grid *, u_int, u_int);
 struct grid_cell *grid_view_get_cell(struct grid *, u_int, u_int);
 void	 grid_view_set_cell(
 	     struct grid *, u_int, u_int, const struct grid_cell *);
+void	 grid_view_set_cells(struct grid *, u_int, u_int,
+	     const struct grid_cell *, const u_char *, size_t);
 void	 grid_view_clear_history(struct grid *);
 void	 grid_view_clear(struct grid *, u_int, u_int, u_int, u_int);
 void	 grid_view_scroll_region_up(struct grid *, u_int, u_int);
@@ -2075,12 +2256,17 @@ void	 screen_write_clearstartofscreen(struct screen_write_ctx *);
 void	 screen_write_clearscreen(struct screen_write_ctx *);
 void	 screen_write_clearhistory(struct screen_write_ctx *);
 void	 screen_write_cell(struct screen_write_ctx *, const struct grid_cell *);
+void	 screen_write_cells(struct screen_write_ctx *, const struct grid_cell *,
+	     const u_char *, size_t);
 void	 screen_write_setselection(struct screen_write_ctx *, u_char *, u_int);
 void	 screen_write_rawstring(struct screen_write_ctx *, u_char *, u_int);
 
 /* screen-redraw.c */
+struct window_map *screen_redraw_get_map(struct window *, u_int, u_int);
+void	 screen_redraw_free_map(struct window *);
 void	 screen_redraw_screen(struct client *, int, int, int);
 void	 screen_redraw_pane(struct client *, struct window_pane *);
+void	 screen_redraw_dirty(struct client *, struct window_pane *);
 
 /* screen.c */
 void	 screen_init(struct screen *, u_int, u_int, u_int);
@@ -2100,6 +2286,8 @@ void	 screen_reflow(struct screen *, u_int);
 /* window.c */
 extern struct windows windows;
 extern struct window_pane_tree all_window_panes;
+int		 window_cmp(struct window *, struct window *);
+RB_PROTOTYPE(windows, window, entry, window_cmp);
 int		 winlink_cmp(struct winlink *, struct winlink *);
 RB_PROTOTYPE(winlinks, winlink, entry, winlink_cmp);
 int		 window_pane_cmp(struct window_pane *, struct window_pane *);
@@ -2120,7 +2308,6 @@ struct winlink	*winlink_previous_by_number(struct winlink *, struct session *,
 		     int);
 void		 winlink_stack_push(struct winlink_stack *, struct winlink *);
 void		 winlink_stack_remove(struct winlink_stack *, struct winlink *);
-int		 window_index(struct window *, u_int *);
 struct window	*window_find_by_id(u_int);
 struct window	*window_create1(u_int, u_int);
 struct window	*window_create(const char *, int, char **, const char *,
@@ -2153,6 +2340,7 @@ int		 window_pane_spawn(struct window_pane *, int, char **,
 		     const char *, const char *, int, struct environ *,
 		     struct termios *, char **);
 void		 window_pane_resize(struct window_pane *, u_int, u_int);
+void		 window_pane_reflow_history(struct window_pane *);
 void		 window_pane_alternate_on(struct window_pane *,
 		     struct grid_cell *, int);
 void		 window_pane_alternate_off(struct window_pane *,
@@ -2164,6 +2352,7 @@ void		 window_pane_key(struct window_pane *, struct session *, int);
 void		 window_pane_mouse(struct window_pane *,
 		     struct session *, struct mouse_event *);
 int		 window_pane_visible(struct window_pane *);
+void		 window_pane_dirty(struct window_pane *, u_int, u_int);
 char		*window_pane_search(
 		     struct window_pane *, const char *, u_int *);
 char		*window_printable_flags(struct session *, struct winlink *);
@@ -2250,6 +2439,8 @@ void	window_choose_set_current(struct window_pane *, u_int);
 
 /* names.c */
 void	 queue_window_name(struct window *);
+void	 unqueue_window_name(struct window *);
+void	 check_window_name(struct window *);
 char	*default_window_name(struct window *);
 char	*format_window_name(struct window *);
 char	*parse_window_name(const char *);
@@ -2259,13 +2450,18 @@ void	set_signals(void(*)(int, short, void *));
 void	clear_signals(int);
 
 /* control.c */
+extern u_int control_high_watermark;
+extern u_int control_low_watermark;
 void	control_callback(struct client *, int, void *);
 void printflike(2, 3) control_write(struct client *, const char *, ...);
 void	control_write_buffer(struct client *, struct evbuffer *);
+void	control_pane_changed(struct client *, struct window_pane *, size_t);
+void	control_check_queued(struct client *);
+void	control_batch_callback(struct client *, int, void *);
+void	control_batch_done(struct cmd_q *, int);
 
 /* control-notify.c */
-void	control_notify_input(struct client *, struct window_pane *,
-	    struct evbuffer *);
+void	control_notify_input(struct window_pane *, struct evbuffer *);
 void	control_notify_window_layout_changed(struct window *);
 void	control_notify_window_unlinked(struct session *, struct window *);
 void	control_notify_window_linked(struct session *, struct window *);
@@ -2332,9 +2528,26 @@ char		*osdep_get_cwd(int);
 struct event_base *osdep_event_init(void);
 
 /* log.c */
+#define LOG_INPUT 0x1
+#define LOG_TTY 0x2
+#define LOG_CMDQ 0x4
+#define LOG_JOB 0x8
+#define LOG_OTHER 0x10
+#define LOG_ALL (LOG_INPUT|LOG_TTY|LOG_CMDQ|LOG_JOB|LOG_OTHER)
+/* Check the subsystem is being logged before evaluating any arguments. */
+#define log_debug(...) log_debug_at(LOG_OTHER, __VA_ARGS__)
+#define log_input(...) log_debug_at(LOG_INPUT, __VA_ARGS__)
+#define log_tty(...) log_debug_at(LOG_TTY, __VA_ARGS__)
+#define log_cmdq(...) log_debug_at(LOG_CMDQ, __VA_ARGS__)
+#define log_job(...) log_debug_at(LOG_JOB, __VA_ARGS__)
+#define log_debug_at(flag, ...) do {					\
+	if (log_flags & (flag))						\
+		log_write(__VA_ARGS__);					\
+} while (0)
+extern int	 log_flags;
 void		 log_open(const char *);
 void		 log_close(void);
-void printflike(1, 2) log_debug(const char *, ...);
+void printflike(1, 2) log_write(const char *, ...);
 __dead void printflike(1, 2) log_fatal(const char *, ...);
 __dead void printflike(1, 2) log_fatalx(const char *, ...);
 
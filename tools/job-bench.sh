@@ -0,0 +1,48 @@
+#!/bin/sh
+# $Id$
+#
+# Time how long run-shell takes to start a job as the server grows. For each
+# number of history lines given (default 0, 200000 and 1000000), start a new
+# server with one pane holding that much history and print its RSS and the
+# time per run-shell job less the time per has-session.
+#
+# usage: job-bench.sh /path/to/tmux [lines ...]
+
+[ -z "$1" ] && echo "usage: $0 tmux [lines ...]" >&2 && exit 1
+TMUX=$1
+shift
+[ $# -eq 0 ] && set -- 0 200000 1000000
+
+RUNS=100
+
+run() {
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt $RUNS ]; do
+		$TMUX -S $SOCKET "$@" || exit 1
+		i=$((i + 1))
+	done
+	echo $(($(date +%s%N) - start))
+}
+
+echo "history	rss	job"
+for lines in "$@"; do
+	SOCKET=${TMPDIR:-/tmp}/job-bench.$$.$lines
+	$TMUX -S $SOCKET -f/dev/null start \; \
+		set -g history-limit $((lines + 1000)) \; \
+		new -d -x80 -y24 "seq 1 $lines; exec cat" || exit 1
+	while :; do
+		size=$($TMUX -S $SOCKET display -p '#{history_size}')
+		[ $size -ge $((lines - 24)) ] && break
+		sleep 1
+	done
+
+	pid=$($TMUX -S $SOCKET display -p '#{pane_pid}')
+	rss=$(ps -o rss= -p $(ps -o ppid= -p $pid))
+
+	base=$(run has-session)
+	job=$(run run-shell true)
+	echo "$lines	$((rss / 1024)) MB	$(((job - base) / RUNS / 1000)) us"
+
+	$TMUX -S $SOCKET kill-server
+done
@@ -0,0 +1,56 @@
+#!/bin/sh
+# $Id$
+#
+# Time window and pane lookups with many windows. Start a server with the
+# given number of windows (default 10000), then time display -p -t @id and
+# display -p -t %id once for every window, each from a sourced file, and ten
+# separate display -p -t @id of the last window.
+#
+# usage: window-bench.sh /path/to/tmux [windows]
+
+[ -z "$1" ] && echo "usage: $0 tmux [windows]" >&2 && exit 1
+TMUX=$1
+WINDOWS=${2:-10000}
+
+SOCKET=${TMPDIR:-/tmp}/window-bench.$$
+FILE=${TMPDIR:-/tmp}/window-bench.$$.conf
+
+ms() {
+	echo $((($(date +%s%N) - $1) / 1000000))
+}
+
+# Panes exit at once and stay open with remain-on-exit, so ptys are freed
+# between each batch of windows.
+$TMUX -S $SOCKET -f/dev/null new -d \; set -g remain-on-exit on || exit 1
+start=$(date +%s%N)
+i=1
+while [ $i -lt $WINDOWS ]; do
+	: >$FILE
+	while [ $i -lt $WINDOWS ]; do
+		echo "neww -d true" >>$FILE
+		i=$((i + 1))
+		[ $((i % 500)) -eq 0 ] && break
+	done
+	$TMUX -S $SOCKET source $FILE || exit 1
+done
+echo "create $WINDOWS windows: $(ms $start) ms"
+
+for type in window pane; do
+	$TMUX -S $SOCKET list-${type}s -a \
+	    -F "display -p -t #{${type}_id} '#{${type}_id}'" >$FILE
+	start=$(date +%s%N)
+	$TMUX -S $SOCKET source $FILE >/dev/null || exit 1
+	echo "display -t each $type: $(ms $start) ms"
+done
+
+last=$($TMUX -S $SOCKET display -p -t :$ '#{window_id}')
+start=$(date +%s%N)
+i=0
+while [ $i -lt 10 ]; do
+	$TMUX -S $SOCKET display -p -t $last '#{window_id}' >/dev/null
+	i=$((i + 1))
+done
+echo "display -t $last 10 times: $(ms $start) ms"
+
+$TMUX -S $SOCKET kill-server
+rm -f $FILE
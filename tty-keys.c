@@ -326,10 +326,10 @@ tty_keys_add(struct tty *tty, const char *s, int key)
 
 	keystr = key_string_lookup_key(key);
 	if ((tk = tty_keys_find(tty, s, strlen(s), &size)) == NULL) {
-		log_debug("new key %s: 0x%x (%s)", s, key, keystr);
+		log_tty("new key %s: 0x%x (%s)", s, key, keystr);
 		tty_keys_add1(&tty->key_tree, s, key);
 	} else {
-		log_debug("replacing key %s: 0x%x (%s)", s, key, keystr);
+		log_tty("replacing key %s: 0x%x (%s)", s, key, keystr);
 		tk->key = key;
 	}
 }
@@ -480,7 +480,7 @@ tty_keys_next(struct tty *tty)
 	len = EVBUFFER_LENGTH(tty->event->input);
 	if (len == 0)
 		return (0);
-	log_debug("keys are %zu (%.*s)", len, (int) len, buf);
+	log_tty("keys are %zu (%.*s)", len, (int) len, buf);
 
 	/* Is this device attributes response? */
 	switch (tty_keys_device(tty, buf, len, &size)) {
@@ -562,7 +562,7 @@ first_key:
 	goto complete_key;
 
 partial_key:
-	log_debug("partial key %.*s", (int) len, buf);
+	log_tty("partial key %.*s", (int) len, buf);
 
 	/* If timer is going, check for expiration. */
 	if (tty->flags & TTY_TIMER) {
@@ -589,7 +589,7 @@ partial_key:
 	return (0);
 
 complete_key:
-	log_debug("complete key %.*s %#x", (int) size, buf, key);
+	log_tty("complete key %.*s %#x", (int) size, buf, key);
 
 	/* Remove data from buffer. */
 	evbuffer_drain(tty->event->input, size);
@@ -615,7 +615,7 @@ complete_key:
 	return (1);
 
 discard_key:
-	log_debug("discard key %.*s %#x", (int) size, buf, key);
+	log_tty("discard key %.*s %#x", (int) size, buf, key);
 
 	/* Remove data from buffer. */
 	evbuffer_drain(tty->event->input, size);
@@ -708,7 +708,7 @@ tty_keys_mouse(struct tty *tty, const char *buf, size_t len, size_t *size)
 			else
 				y = value;
 		}
-		log_debug("mouse input: %.*s", (int) *size, buf);
+		log_tty("mouse input: %.*s", (int) *size, buf);
 
 		/* Check and return the mouse input. */
 		if (b < 32)
@@ -755,7 +755,7 @@ tty_keys_mouse(struct tty *tty, const char *buf, size_t len, size_t *size)
 				return (-1);
 			y = 10 * y + (c - '0');
 		}
-		log_debug("mouse input (sgr): %.*s", (int) *size, buf);
+		log_tty("mouse input (sgr): %.*s", (int) *size, buf);
 
 		/* Check and return the mouse input. */
 		if (x < 1 || y < 1)
@@ -884,7 +884,7 @@ tty_keys_device(struct tty *tty, const char *buf, size_t len, size_t *size)
 	if (*endptr != ';')
 		class = 0;
 
-	log_debug("received service class %u", class);
+	log_tty("received service class %u", class);
 	tty_set_class(tty, class);
 
 	return (0);
@@ -309,7 +309,7 @@ tty_term_override(struct tty_term *term, const char *overrides)
 			} else
 				val = xstrdup("");
 
-			log_debug("%s override: %s %s",
+			log_tty("%s override: %s %s",
 			    term->name, entstr, removeflag ? "@" : val);
 			for (i = 0; i < NTTYCODE; i++) {
 				ent = &tty_term_codes[i];
@@ -369,7 +369,7 @@ tty_term_find(char *name, int fd, char **cause)
 		}
 	}
 
-	log_debug("new term: %s", name);
+	log_tty("new term: %s", name);
 	term = xmalloc(sizeof *term);
 	term->name = xstrdup(name);
 	term->references = 1;
@@ -48,6 +48,14 @@ void	tty_emulate_repeat(
 	    struct tty *, enum tty_code_code, enum tty_code_code, u_int);
 void	tty_repeat_space(struct tty *, u_int);
 void	tty_cell(struct tty *, const struct grid_cell *);
+void	tty_add(struct tty *, const void *, size_t);
+int	tty_write_dirty(void (*)(struct tty *, const struct tty_ctx *),
+	    const struct tty_ctx *);
+int	tty_draw_line_clear(struct tty *, struct screen *, u_int, u_int,
+	    u_int, u_int, u_int);
+void	tty_shadow_check(struct tty *);
+void	tty_shadow_set(struct tty *, u_int, u_int, const struct grid_cell *);
+void	tty_send(struct tty *, const void *, size_t);
 
 #define tty_use_acs(tty) \
 	(tty_term_has((tty)->term, TTYC_ACSC) && !((tty)->flags & TTY_UTF8))
@@ -55,6 +63,12 @@ void	tty_cell(struct tty *, const struct grid_cell *);
 #define tty_pane_full_width(tty, ctx) \
 	((ctx)->xoff == 0 && screen_size_x((ctx)->wp->screen) >= (tty)->sx)
 
+/*
+ * Size of the output staging buffer. Output is collected here and handed to
+ * the bufferevent in one piece at the end of each server loop.
+ */
+#define TTY_BUFFER_SIZE 16384
+
 void
 tty_init(struct tty *tty, struct client *c, int fd, char *term)
 {
@@ -150,6 +164,9 @@ tty_open(struct tty *tty, char **cause)
 
 	tty->flags &= ~(TTY_NOCURSOR|TTY_FREEZE|TTY_TIMER);
 
+	tty->obuf = xmalloc(TTY_BUFFER_SIZE);
+	tty->obuflen = 0;
+
 	tty->event = bufferevent_new(
 	    tty->fd, tty_read_callback, NULL, tty_error_callback, tty);
 
@@ -235,6 +252,9 @@ tty_start_tty(struct tty *tty)
 
 	tty->mode = MODE_CURSOR;
 
+	if (tty->shadow != NULL)
+		tty_shadow_free(tty);
+
 	tty->flags |= TTY_STARTED;
 
 	tty_force_cursor_colour(tty, "");
@@ -257,6 +277,7 @@ tty_stop_tty(struct tty *tty)
 		return;
 	tty->flags &= ~TTY_STARTED;
 
+	tty_flush(tty);
 	bufferevent_disable(tty->event, EV_READ|EV_WRITE);
 
 	/*
@@ -316,6 +337,10 @@ tty_close(struct tty *tty)
 	if (tty->flags & TTY_OPENED) {
 		bufferevent_free(tty->event);
 
+		free(tty->obuf);
+		tty->obuf = NULL;
+		tty->obuflen = 0;
+
 		tty_term_free(tty->term);
 		tty_keys_free(tty);
 
@@ -332,6 +357,7 @@ void
 tty_free(struct tty *tty)
 {
 	tty_close(tty);
+	tty_shadow_free(tty);
 
 	free(tty->ccolour);
 	if (tty->path != NULL)
@@ -397,15 +423,49 @@ tty_putcode_ptr2(struct tty *tty, enum tty_code_code code, const void *a,
 		tty_puts(tty, tty_term_ptr2(tty->term, code, a, b));
 }
 
+/* Hand data to the bufferevent and count it. */
+void
+tty_send(struct tty *tty, const void *buf, size_t len)
+{
+	bufferevent_write(tty->event, buf, len);
+	if (tty->log_fd != -1)
+		write(tty->log_fd, buf, len);
+
+	tty->written += len;
+	tty->flushes++;
+}
+
+/* Add data to the staging buffer, flushing first if it would not fit. */
+void
+tty_add(struct tty *tty, const void *buf, size_t len)
+{
+	if (tty->obuflen + len > TTY_BUFFER_SIZE) {
+		tty_flush(tty);
+		if (len > TTY_BUFFER_SIZE) {
+			tty_send(tty, buf, len);
+			return;
+		}
+	}
+	memcpy(tty->obuf + tty->obuflen, buf, len);
+	tty->obuflen += len;
+}
+
+/* Write any staged output to the terminal. */
+void
+tty_flush(struct tty *tty)
+{
+	if (tty->obuflen == 0)
+		return;
+	tty_send(tty, tty->obuf, tty->obuflen);
+	tty->obuflen = 0;
+}
+
 void
 tty_puts(struct tty *tty, const char *s)
 {
 	if (*s == '\0')
 		return;
-	bufferevent_write(tty->event, s, strlen(s));
-
-	if (tty->log_fd != -1)
-		write(tty->log_fd, s, strlen(s));
+	tty_add(tty, s, strlen(s));
 }
 
 void
@@ -417,11 +477,13 @@ tty_putc(struct tty *tty, u_char ch)
 	if (tty->cell.attr & GRID_ATTR_CHARSET) {
 		acs = tty_acs_get(tty, ch);
 		if (acs != NULL)
-			bufferevent_write(tty->event, acs, strlen(acs));
+			tty_add(tty, acs, strlen(acs));
 		else
-			bufferevent_write(tty->event, &ch, 1);
-	} else
-		bufferevent_write(tty->event, &ch, 1);
+			tty_add(tty, &ch, 1);
+	} else if (tty->obuflen < TTY_BUFFER_SIZE)
+		tty->obuf[tty->obuflen++] = ch;
+	else
+		tty_add(tty, &ch, 1);
 
 	if (ch >= 0x20 && ch != 0x7f) {
 		sx = tty->sx;
@@ -435,17 +497,12 @@ tty_putc(struct tty *tty, u_char ch)
 		} else
 			tty->cx++;
 	}
-
-	if (tty->log_fd != -1)
-		write(tty->log_fd, &ch, 1);
 }
 
 void
 tty_putn(struct tty *tty, const void *buf, size_t len, u_int width)
 {
-	bufferevent_write(tty->event, buf, len);
-	if (tty->log_fd != -1)
-		write(tty->log_fd, buf, len);
+	tty_add(tty, buf, len);
 	tty->cx += width;
 }
 
@@ -615,7 +672,7 @@ void
 tty_draw_line(struct tty *tty, struct screen *s, u_int py, u_int ox, u_int oy)
 {
 	const struct grid_cell	*gc;
-	struct grid_line	*gl;
+	const struct grid_line	*gl;
 	struct grid_cell	 tmpgc;
 	struct utf8_data	 ud;
 	u_int			 i, sx;
@@ -623,8 +680,9 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int py, u_int ox, u_int oy)
 	tty_update_mode(tty, tty->mode & ~MODE_CURSOR, s);
 
 	sx = screen_size_x(s);
-	if (sx > s->grid->linedata[s->grid->hsize + py].cellsize)
-		sx = s->grid->linedata[s->grid->hsize + py].cellsize;
+	gl = grid_peek_line(s->grid, s->grid->hsize + py);
+	if (sx > gl->cellsize)
+		sx = gl->cellsize;
 	if (sx > tty->sx)
 		sx = tty->sx;
 
@@ -634,7 +692,7 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int py, u_int ox, u_int oy)
 	 */
 	gl = NULL;
 	if (py != 0)
-		gl = &s->grid->linedata[s->grid->hsize + py - 1];
+		gl = grid_peek_line(s->grid, s->grid->hsize + py - 1);
 	if (oy + py == 0 || gl == NULL || !(gl->flags & GRID_LINE_WRAPPED) ||
 	    tty->cx < tty->sx || ox != 0 ||
 	    (oy + py != tty->cy + 1 && tty->cy != s->rlower + oy))
@@ -650,10 +708,13 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int py, u_int ox, u_int oy)
 			    ~(GRID_FLAG_FG256|GRID_FLAG_BG256);
 			tmpgc.flags |= s->sel.cell.flags &
 			    (GRID_FLAG_FG256|GRID_FLAG_BG256);
-			tty_cell(tty, &tmpgc);
-		} else
-			tty_cell(tty, gc);
+			gc = &tmpgc;
+		}
+		tty_cell(tty, gc);
+		tty_shadow_set(tty, ox + i, oy + py, gc);
 	}
+	for (i = sx; i < screen_size_x(s); i++)
+		tty_shadow_set(tty, ox + i, oy + py, &grid_default_cell);
 
 	if (sx >= tty->sx) {
 		tty_update_mode(tty, tty->mode, s);
@@ -670,6 +731,135 @@ tty_draw_line(struct tty *tty, struct screen *s, u_int py, u_int ox, u_int oy)
 	tty_update_mode(tty, tty->mode, s);
 }
 
+/*
+ * Draw a line, only writing cells which differ from what the terminal is
+ * already showing.
+ */
+void
+tty_draw_line_diff(struct tty *tty, struct screen *s, u_int py, u_int ox,
+    u_int oy)
+{
+	const struct grid_cell	*gc;
+	struct grid_cell	 tmpgc, *sc;
+	struct utf8_data	 ud;
+	u_int			 i, sx, cellsize;
+	int			 changed = 0;
+
+	tty_shadow_check(tty);
+	if (oy + py > tty->sy - 1 || ox > tty->sx - 1)
+		return;
+
+	sx = screen_size_x(s);
+	if (sx > tty->sx - ox)
+		sx = tty->sx - ox;
+	cellsize = grid_peek_line(s->grid, s->grid->hsize + py)->cellsize;
+
+	sc = &tty->shadow[(oy + py) * tty->sx + ox];
+	for (i = 0; i < sx; i++) {
+		if (i >= cellsize) {
+			if (tty_draw_line_clear(tty, s, py, ox, oy, i, sx))
+				changed = 1;
+			break;
+		}
+
+		gc = grid_view_peek_cell(s->grid, i, py);
+		if (screen_check_selection(s, i, py)) {
+			memcpy(&tmpgc, &s->sel.cell, sizeof tmpgc);
+			grid_cell_get(gc, &ud);
+			grid_cell_set(&tmpgc, &ud);
+			tmpgc.flags = gc->flags &
+			    ~(GRID_FLAG_FG256|GRID_FLAG_BG256);
+			tmpgc.flags |= s->sel.cell.flags &
+			    (GRID_FLAG_FG256|GRID_FLAG_BG256);
+			gc = &tmpgc;
+		}
+		if (memcmp(&sc[i], gc, sizeof sc[i]) == 0)
+			continue;
+
+		if (!changed) {
+			tty_update_mode(tty, tty->mode & ~MODE_CURSOR, s);
+			changed = 1;
+		}
+		if (!(gc->flags & GRID_FLAG_PADDING)) {
+			tty_cursor(tty, ox + i, oy + py);
+			tty_cell(tty, gc);
+		}
+		memcpy(&sc[i], gc, sizeof sc[i]);
+	}
+
+	if (changed)
+		tty_update_mode(tty, tty->mode, s);
+}
+
+/*
+ * Clear the end of a line from cell px if the terminal isn't already showing
+ * it empty. Returns 1 if anything was drawn.
+ */
+int
+tty_draw_line_clear(struct tty *tty, struct screen *s, u_int py, u_int ox,
+    u_int oy, u_int px, u_int sx)
+{
+	struct grid_cell	*sc;
+	u_int			 i;
+
+	sc = &tty->shadow[(oy + py) * tty->sx + ox];
+	for (i = px; i < sx; i++) {
+		if (memcmp(&sc[i], &grid_default_cell, sizeof sc[i]) != 0)
+			break;
+	}
+	if (i == sx)
+		return (0);
+
+	tty_update_mode(tty, tty->mode & ~MODE_CURSOR, s);
+	tty_reset(tty);
+	tty_cursor(tty, ox + i, oy + py);
+	if (ox + screen_size_x(s) >= tty->sx && tty_term_has(tty->term, TTYC_EL))
+		tty_putcode(tty, TTYC_EL);
+	else
+		tty_repeat_space(tty, sx - i);
+	for (; i < sx; i++)
+		memcpy(&sc[i], &grid_default_cell, sizeof sc[i]);
+	return (1);
+}
+
+/* Make sure the shadow exists and is the same size as the terminal. */
+void
+tty_shadow_check(struct tty *tty)
+{
+	if (tty->shadow != NULL &&
+	    tty->shadowsx == tty->sx && tty->shadowsy == tty->sy)
+		return;
+
+	/* Cells with all bits set never match a real cell, so are redrawn. */
+	tty->shadow = xreallocarray(tty->shadow, tty->sx * tty->sy,
+	    sizeof *tty->shadow);
+	memset(tty->shadow, 0xff, tty->sx * tty->sy * sizeof *tty->shadow);
+	tty->shadowsx = tty->sx;
+	tty->shadowsy = tty->sy;
+}
+
+/* Record a cell written to the terminal. */
+void
+tty_shadow_set(struct tty *tty, u_int px, u_int py, const struct grid_cell *gc)
+{
+	if (tty->shadow == NULL)
+		return;
+	if (tty->shadowsx != tty->sx || tty->shadowsy != tty->sy)
+		return;
+	if (px > tty->sx - 1 || py > tty->sy - 1)
+		return;
+	memcpy(&tty->shadow[py * tty->sx + px], gc, sizeof *tty->shadow);
+}
+
+/* Discard the shadow. */
+void
+tty_shadow_free(struct tty *tty)
+{
+	free(tty->shadow);
+	tty->shadow = NULL;
+	tty->shadowsx = tty->shadowsy = 0;
+}
+
 void
 tty_write(
     void (*cmdfn)(struct tty *, const struct tty_ctx *), struct tty_ctx *ctx)
@@ -687,6 +877,13 @@ tty_write(
 	if (!window_pane_visible(wp) || wp->flags & PANE_DROP)
 		return;
 
+	/*
+	 * If redrawing is deferred, mark the changed lines rather than
+	 * drawing them now.
+	 */
+	if (redraw_interval != 0 && tty_write_dirty(cmdfn, ctx))
+		return;
+
 	for (i = 0; i < ARRAY_LENGTH(&clients); i++) {
 		c = ARRAY_ITEM(&clients, i);
 		if (c == NULL || c->session == NULL || c->tty.term == NULL)
@@ -707,6 +904,48 @@ tty_write(
 	}
 }
 
+/*
+ * Mark the lines a command changes as dirty. Returns 0 if the command must
+ * be written to the terminal immediately.
+ */
+int
+tty_write_dirty(void (*cmdfn)(struct tty *, const struct tty_ctx *),
+    const struct tty_ctx *ctx)
+{
+	struct window_pane	*wp = ctx->wp;
+	u_int			 upper, lower;
+
+	if (cmdfn == tty_cmd_setselection || cmdfn == tty_cmd_rawstring)
+		return (0);
+
+	upper = lower = ctx->ocy;
+	if (cmdfn == tty_cmd_cell) {
+		/* The cell may have wrapped onto the next line. */
+		lower++;
+	} else if (cmdfn == tty_cmd_linefeed) {
+		if (ctx->ocy != ctx->orlower)
+			return (1);
+		upper = ctx->orupper;
+	} else if (cmdfn == tty_cmd_reverseindex) {
+		if (ctx->ocy != ctx->orupper)
+			return (1);
+		lower = ctx->orlower;
+	} else if (cmdfn == tty_cmd_insertline ||
+	    cmdfn == tty_cmd_deleteline ||
+	    cmdfn == tty_cmd_clearendofscreen)
+		lower = UINT_MAX;
+	else if (cmdfn == tty_cmd_clearstartofscreen)
+		upper = 0;
+	else if (cmdfn == tty_cmd_clearscreen ||
+	    cmdfn == tty_cmd_alignmenttest) {
+		upper = 0;
+		lower = UINT_MAX;
+	}
+
+	window_pane_dirty(wp, upper, lower);
+	return (1);
+}
+
 void
 tty_cmd_insertcharacter(struct tty *tty, const struct tty_ctx *ctx)
 {
@@ -1046,6 +1285,35 @@ tty_cmd_cell(struct tty *tty, const struct tty_ctx *ctx)
 	tty_cell(tty, ctx->cell);
 }
 
+void
+tty_cmd_cells(struct tty *tty, const struct tty_ctx *ctx)
+{
+	const u_char		*buf = ctx->ptr;
+	struct grid_cell	 gc;
+	u_int			 i;
+
+	tty_region_pane(tty, ctx, ctx->orupper, ctx->orlower);
+	tty_cursor_pane(tty, ctx, ctx->ocx, ctx->ocy);
+
+	/*
+	 * If the characters may need translating or the cursor position needs
+	 * to be tracked as they are written, do them one at a time.
+	 */
+	if ((tty->term->flags & TERM_EARLYWRAP) ||
+	    (ctx->cell->attr & GRID_ATTR_CHARSET) ||
+	    tty->cx + ctx->num > tty->sx) {
+		memcpy(&gc, ctx->cell, sizeof gc);
+		for (i = 0; i < ctx->num; i++) {
+			grid_cell_one(&gc, buf[i]);
+			tty_cell(tty, &gc);
+		}
+		return;
+	}
+
+	tty_attributes(tty, ctx->cell);
+	tty_putn(tty, buf, ctx->num, ctx->num);
+}
+
 void
 tty_cmd_utf8character(struct tty *tty, const struct tty_ctx *ctx)
 {
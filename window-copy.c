@@ -264,6 +264,7 @@ window_copy_init_from_pane(struct window_pane *wp)
 		fatalx("not in copy mode");
 
 	data->backing = &wp->base;
+	window_pane_reflow_history(wp);
 	data->cx = data->backing->cx;
 	data->cy = data->backing->cy;
 
@@ -391,8 +392,11 @@ window_copy_resize(struct window_pane *wp, u_int sx, u_int sy)
 	struct screen_write_ctx	 	 ctx;
 
 	screen_resize(s, sx, sy, 1);
-	if (data->backing != &wp->base)
+	if (data->backing != &wp->base) {
 		screen_resize(data->backing, sx, sy, 1);
+		grid_reflow_history(data->backing->grid);
+	} else
+		window_pane_reflow_history(wp);
 
 	if (data->cy > sy - 1)
 		data->cy = sy - 1;
@@ -1661,7 +1665,7 @@ window_copy_copy_line(struct window_pane *wp,
 	struct window_copy_mode_data	*data = wp->modedata;
 	struct grid			*gd = data->backing->grid;
 	const struct grid_cell		*gc;
-	struct grid_line		*gl;
+	const struct grid_line		*gl;
 	struct utf8_data		 ud;
 	u_int				 i, xx, wrapped = 0;
 	const char			*s;
@@ -1673,7 +1677,7 @@ window_copy_copy_line(struct window_pane *wp,
 	 * Work out if the line was wrapped at the screen edge and all of it is
 	 * on screen.
 	 */
-	gl = &gd->linedata[sy];
+	gl = grid_peek_line(gd, sy);
 	if (gl->flags & GRID_LINE_WRAPPED && gl->cellsize <= gd->sx)
 		wrapped = 1;
 
@@ -1760,7 +1764,7 @@ window_copy_find_length(struct window_pane *wp, u_int py)
 	 * width of the grid, and screen_write_copy treats them as spaces, so
 	 * ignore them here too.
 	 */
-	px = s->grid->linedata[py].cellsize;
+	px = grid_peek_line(s->grid, py)->cellsize;
 	if (px > screen_size_x(s))
 		px = screen_size_x(s);
 	while (px > 0) {
@@ -1785,7 +1789,7 @@ window_copy_cursor_start_of_line(struct window_pane *wp)
 	if (data->cx == 0 && s->sel.lineflag == LINE_SEL_NONE) {
 		py = screen_hsize(back_s) + data->cy - data->oy;
 		while (py > 0 &&
-		    gd->linedata[py-1].flags & GRID_LINE_WRAPPED) {
+		    grid_peek_line(gd, py - 1)->flags & GRID_LINE_WRAPPED) {
 			window_copy_cursor_up(wp, 0);
 			py = screen_hsize(back_s) + data->cy - data->oy;
 		}
@@ -1841,9 +1845,9 @@ window_copy_cursor_end_of_line(struct window_pane *wp)
 	if (data->cx == px && s->sel.lineflag == LINE_SEL_NONE) {
 		if (data->screen.sel.flag && data->rectflag)
 			px = screen_size_x(back_s);
-		if (gd->linedata[py].flags & GRID_LINE_WRAPPED) {
+		if (grid_peek_line(gd, py)->flags & GRID_LINE_WRAPPED) {
 			while (py < gd->sy + gd->hsize &&
-			    gd->linedata[py].flags & GRID_LINE_WRAPPED) {
+			    grid_peek_line(gd, py)->flags & GRID_LINE_WRAPPED) {
 				window_copy_cursor_down(wp, 0);
 				py = screen_hsize(back_s)
 				     + data->cy - data->oy;
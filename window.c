@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fnmatch.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -42,13 +43,13 @@
  * Each pane also has a "virtual" screen (screen.c) which contains the current
  * state and is redisplayed when the window is reattached to a client.
  *
- * Windows are stored directly on a global array and wrapped in any number of
- * winlink structs to be linked onto local session RB trees. A reference count
- * is maintained and a window removed from the global list and destroyed when
- * it reaches zero.
+ * Windows are stored directly on a global tree and wrapped in any number of
+ * winlink structs to be linked onto local session RB trees. Each window keeps
+ * a list of its winlinks. A reference count is maintained and a window removed
+ * from the global tree and destroyed when it reaches zero.
  */
 
-/* Global window list. */
+/* Global window tree, ordered by id. */
 struct windows windows;
 
 /* Global panes tree. */
@@ -60,9 +61,18 @@ u_int	next_active_point;
 void	window_pane_timer_callback(int, short, void *);
 void	window_pane_read_callback(struct bufferevent *, void *);
 void	window_pane_error_callback(struct bufferevent *, short, void *);
+void	window_pane_freeze_history(struct window_pane *);
 
 struct window_pane *window_pane_choose_best(struct window_pane_list *);
 
+RB_GENERATE(windows, window, entry, window_cmp);
+
+int
+window_cmp(struct window *w1, struct window *w2)
+{
+	return (w1->id - w2->id);
+}
+
 RB_GENERATE(winlinks, winlink, entry, winlink_cmp);
 
 int
@@ -79,17 +89,23 @@ window_pane_cmp(struct window_pane *wp1, struct window_pane *wp2)
 	return (wp1->id - wp2->id);
 }
 
+/*
+ * Find the winlink for a window. Only the window's own winlinks are checked,
+ * each by looking up its index.
+ */
 struct winlink *
 winlink_find_by_window(struct winlinks *wwl, struct window *w)
 {
-	struct winlink	*wl;
+	struct winlink	*wl, *found = NULL;
 
-	RB_FOREACH(wl, winlinks, wwl) {
-		if (wl->window == w)
-			return (wl);
+	TAILQ_FOREACH(wl, &w->winlinks, wentry) {
+		if (found != NULL && wl->idx > found->idx)
+			continue;
+		if (RB_FIND(winlinks, wwl, wl) == wl)
+			found = wl;
 	}
 
-	return (NULL);
+	return (found);
 }
 
 struct winlink *
@@ -107,13 +123,11 @@ winlink_find_by_index(struct winlinks *wwl, int idx)
 struct winlink *
 winlink_find_by_window_id(struct winlinks *wwl, u_int id)
 {
-	struct winlink *wl;
+	struct window	*w;
 
-	RB_FOREACH(wl, winlinks, wwl) {
-		if (wl->window->id == id)
-			return (wl);
-	}
-	return (NULL);
+	if ((w = window_find_by_id(id)) == NULL)
+		return (NULL);
+	return (winlink_find_by_window(wwl, w));
 }
 
 int
@@ -168,6 +182,7 @@ void
 winlink_set_window(struct winlink *wl, struct window *w)
 {
 	wl->window = w;
+	TAILQ_INSERT_TAIL(&w->winlinks, wl, wentry);
 	w->references++;
 }
 
@@ -177,6 +192,8 @@ winlink_remove(struct winlinks *wwl, struct winlink *wl)
 	struct window	*w = wl->window;
 
 	RB_REMOVE(winlinks, wwl, wl);
+	if (w != NULL)
+		TAILQ_REMOVE(&w->winlinks, wl, wentry);
 	free(wl->status_text);
 	free(wl);
 
@@ -244,35 +261,19 @@ winlink_stack_remove(struct winlink_stack *stack, struct winlink *wl)
 	}
 }
 
-int
-window_index(struct window *s, u_int *i)
-{
-	for (*i = 0; *i < ARRAY_LENGTH(&windows); (*i)++) {
-		if (s == ARRAY_ITEM(&windows, *i))
-			return (0);
-	}
-	return (-1);
-}
-
 struct window *
 window_find_by_id(u_int id)
 {
-	struct window	*w;
-	u_int		 i;
+	struct window	w;
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		w = ARRAY_ITEM(&windows, i);
-		if (w != NULL && w->id == id)
-			return (w);
-	}
-	return (NULL);
+	w.id = id;
+	return (RB_FIND(windows, &windows, &w));
 }
 
 struct window *
 window_create1(u_int sx, u_int sy)
 {
 	struct window	*w;
-	u_int		 i;
 
 	w = xcalloc(1, sizeof *w);
 	w->id = next_window_id++;
@@ -289,17 +290,12 @@ window_create1(u_int sx, u_int sy)
 	w->sy = sy;
 
 	options_init(&w->options, &global_w_options);
-	if (options_get_number(&w->options, "automatic-rename"))
-		queue_window_name(w);
+	w->name_pane = UINT_MAX;
+	w->name_pgrp = -1;
+	queue_window_name(w);
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		if (ARRAY_ITEM(&windows, i) == NULL) {
-			ARRAY_SET(&windows, i, w);
-			break;
-		}
-	}
-	if (i == ARRAY_LENGTH(&windows))
-		ARRAY_ADD(&windows, w);
+	TAILQ_INIT(&w->winlinks);
+	RB_INSERT(windows, &windows, w);
 	w->references = 0;
 
 	return (w);
@@ -336,21 +332,16 @@ window_create(const char *name, int argc, char **argv, const char *path,
 void
 window_destroy(struct window *w)
 {
-	u_int	i;
-
 	window_unzoom(w);
 
-	if (window_index(w, &i) != 0)
-		fatalx("index not found");
-	ARRAY_SET(&windows, i, NULL);
-	while (!ARRAY_EMPTY(&windows) && ARRAY_LAST(&windows) == NULL)
-		ARRAY_TRUNC(&windows, 1);
+	RB_REMOVE(windows, &windows, w);
 
 	if (w->layout_root != NULL)
 		layout_free(w);
+	screen_redraw_free_map(w);
 
-	if (event_initialized(&w->name_timer))
-		evtimer_del(&w->name_timer);
+	unqueue_window_name(w);
+	server_window_unqueue_alerts(w);
 
 	options_free(&w->options);
 
@@ -406,18 +397,15 @@ window_set_active_pane(struct window *w, struct window_pane *wp)
 struct window_pane *
 window_get_active_at(struct window *w, u_int x, u_int y)
 {
-	struct window_pane	*wp;
+	struct window_map	*map;
+	u_int			 n;
 
-	TAILQ_FOREACH(wp, &w->panes, entry) {
-		if (!window_pane_visible(wp))
-			continue;
-		if (x < wp->xoff || x > wp->xoff + wp->sx)
-			continue;
-		if (y < wp->yoff || y > wp->yoff + wp->sy)
-			continue;
-		return (wp);
-	}
-	return (NULL);
+	map = screen_redraw_get_map(w, x + 1, y + 1);
+	if (x >= map->sx || y >= map->sy)
+		return (NULL);
+	if ((n = map->at[y * map->sx + x]) == 0)
+		return (NULL);
+	return (map->panes[n - 1].wp);
 }
 
 void
@@ -753,13 +741,19 @@ window_pane_spawn(struct window_pane *wp, int argc, char **argv,
     struct termios *tio, char **cause)
 {
 	struct winsize	 ws;
-	char		*argv0, *cmd, **argvp, paneid[16];
-	const char	*ptr, *first;
+	struct environ	 newenv;
+	char		*argv0, *cmd, **argvp, **envp, **oldenviron;
+	char		 paneid[16];
+	const char	*ptr;
 	struct termios	 tio2;
+	sigset_t	 set, oldset;
 #ifdef HAVE_UTEMPTER
 	char		 s[32];
 #endif
-	int		 i;
+	int		 i, utf8, maxfd;
+#if defined(HAVE_OPENPTY) && defined(HAVE_LOGIN_TTY)
+	int		 slave;
+#endif
 
 	if (wp->fd != -1) {
 		bufferevent_free(wp->event);
@@ -788,10 +782,72 @@ window_pane_spawn(struct window_pane *wp, int argc, char **argv,
 	ws.ws_col = screen_size_x(&wp->base);
 	ws.ws_row = screen_size_y(&wp->base);
 
-	switch (wp->pid = forkpty(&wp->fd, wp->tty, NULL, &ws)) {
+	/*
+	 * Work out the environment and command first, so the child only has
+	 * to make system calls before exec and can be started with vfork()
+	 * rather than copying the whole server.
+	 */
+	environ_init(&newenv);
+	environ_copy(env, &newenv);
+	if (path != NULL)
+		environ_set(&newenv, "PATH", path);
+	xsnprintf(paneid, sizeof paneid, "%%%u", wp->id);
+	environ_set(&newenv, "TMUX_PANE", paneid);
+	environ_set(&newenv, "SHELL", wp->shell);
+	envp = environ_array(&newenv);
+	environ_free(&newenv);
+
+	/*
+	 * If given one argument, assume it should be passed to sh -c; with
+	 * more than one argument, use execvp(). If there is no arguments,
+	 * create a login shell.
+	 */
+	argvp = NULL;
+	argv0 = NULL;
+	if (wp->argc > 1) {
+		/* Copy to ensure argv ends in NULL. */
+		argvp = cmd_copy_argv(wp->argc, wp->argv);
+	} else {
+		ptr = strrchr(wp->shell, '/');
+		if (ptr != NULL && *(ptr + 1) != '\0')
+			ptr++;
+		else
+			ptr = wp->shell;
+		xasprintf(&argv0, "%s%s", wp->argc == 0 ? "-" : "", ptr);
+	}
+	utf8 = options_get_number(&wp->window->options, "utf8");
+
+	maxfd = getdtablesize();
+
+	/* Block signals so the handlers cannot run in the child. */
+	sigfillset(&set);
+	sigprocmask(SIG_BLOCK, &set, &oldset);
+	oldenviron = environ;
+
+#if defined(HAVE_OPENPTY) && defined(HAVE_LOGIN_TTY)
+	slave = -1;
+	if (openpty(&wp->fd, &slave, wp->tty, NULL, &ws) != 0)
+		wp->pid = -1;
+	else if ((wp->pid = vfork()) == 0 && login_tty(slave) != 0)
+		_exit(1);
+#else
+	wp->pid = forkpty(&wp->fd, wp->tty, NULL, &ws);
+#endif
+	switch (wp->pid) {
 	case -1:
-		wp->fd = -1;
 		xasprintf(cause, "%s: %s", cmd, strerror(errno));
+		sigprocmask(SIG_SETMASK, &oldset, NULL);
+#if defined(HAVE_OPENPTY) && defined(HAVE_LOGIN_TTY)
+		if (slave != -1) {
+			close(wp->fd);
+			close(slave);
+		}
+#endif
+		wp->fd = -1;
+		environ_free_array(envp);
+		if (argvp != NULL)
+			cmd_free_argv(wp->argc, argvp);
+		free(argv0);
 		free(cmd);
 		return (-1);
 	case 0:
@@ -799,60 +855,43 @@ window_pane_spawn(struct window_pane *wp, int argc, char **argv,
 			chdir("/");
 
 		if (tcgetattr(STDIN_FILENO, &tio2) != 0)
-			fatal("tcgetattr failed");
+			_exit(1);
 		if (tio != NULL)
 			memcpy(tio2.c_cc, tio->c_cc, sizeof tio2.c_cc);
 		tio2.c_cc[VERASE] = '\177';
 #ifdef IUTF8
-		if (options_get_number(&wp->window->options, "utf8"))
+		if (utf8)
 			tio2.c_iflag |= IUTF8;
 #endif
 		if (tcsetattr(STDIN_FILENO, TCSANOW, &tio2) != 0)
-			fatal("tcgetattr failed");
-
-		closefrom(STDERR_FILENO + 1);
+			_exit(1);
 
-		if (path != NULL)
-			environ_set(env, "PATH", path);
-		xsnprintf(paneid, sizeof paneid, "%%%u", wp->id);
-		environ_set(env, "TMUX_PANE", paneid);
-		environ_push(env);
+		closefrom_vfork(STDERR_FILENO + 1, maxfd);
 
 		clear_signals(1);
-		log_close();
-
-		setenv("SHELL", wp->shell, 1);
-		ptr = strrchr(wp->shell, '/');
-
-		/*
-		 * If given one argument, assume it should be passed to sh -c;
-		 * with more than one argument, use execvp(). If there is no
-		 * arguments, create a login shell.
-		 */
-		if (wp->argc > 0) {
-			if (wp->argc != 1) {
-				/* Copy to ensure argv ends in NULL. */
-				argvp = cmd_copy_argv(wp->argc, wp->argv);
-				execvp(argvp[0], argvp);
-				fatal("execvp failed");
-			}
-			first = wp->argv[0];
-
-			if (ptr != NULL && *(ptr + 1) != '\0')
-				xasprintf(&argv0, "%s", ptr + 1);
-			else
-				xasprintf(&argv0, "%s", wp->shell);
-			execl(wp->shell, argv0, "-c", first, (char *)NULL);
-			fatal("execl failed");
-		}
-		if (ptr != NULL && *(ptr + 1) != '\0')
-			xasprintf(&argv0, "-%s", ptr + 1);
+		sigprocmask(SIG_SETMASK, &oldset, NULL);
+
+		/* This changes the parent's environ too, it is put back. */
+		environ = envp;
+		if (argvp != NULL)
+			execvp(argvp[0], argvp);
+		else if (wp->argc == 1)
+			execl(wp->shell, argv0, "-c", wp->argv[0], (char *)NULL);
 		else
-			xasprintf(&argv0, "-%s", wp->shell);
-		execl(wp->shell, argv0, (char *)NULL);
-		fatal("execl failed");
+			execl(wp->shell, argv0, (char *)NULL);
+		_exit(1);
 	}
 
+	environ = oldenviron;
+	sigprocmask(SIG_SETMASK, &oldset, NULL);
+#if defined(HAVE_OPENPTY) && defined(HAVE_LOGIN_TTY)
+	close(slave);
+#endif
+	environ_free_array(envp);
+	if (argvp != NULL)
+		cmd_free_argv(wp->argc, argvp);
+	free(argv0);
+
 #ifdef HAVE_UTEMPTER
 	xsnprintf(s, sizeof s, "tmux(%lu).%%%u", (long) getpid(), wp->id);
 	utempter_add_record(wp->fd, s);
@@ -918,6 +957,8 @@ window_pane_read_callback(unused struct bufferevent *bufev, void *data)
 	}
 
 	input_parse(wp);
+	window_pane_freeze_history(wp);
+	queue_window_name(wp->window);
 
 	wp->pipe_off = EVBUFFER_LENGTH(wp->event->input);
 
@@ -928,6 +969,7 @@ window_pane_read_callback(unused struct bufferevent *bufev, void *data)
 	wp->window->flags |= WINDOW_SILENCE;
 	if (gettimeofday(&wp->window->silence_timer, NULL) != 0)
 		fatal("gettimeofday failed.");
+	server_window_queue_alerts(wp->window);
 }
 
 void
@@ -936,6 +978,7 @@ window_pane_error_callback(
 {
 	struct window_pane *wp = data;
 
+	queue_window_name(wp->window);
 	server_destroy_pane(wp);
 }
 
@@ -950,10 +993,58 @@ window_pane_resize(struct window_pane *wp, u_int sx, u_int sy)
 	screen_resize(&wp->base, sx, sy, wp->saved_grid == NULL);
 	if (wp->mode != NULL)
 		wp->mode->resize(wp, sx, sy);
+	window_pane_freeze_history(wp);
 
 	wp->flags |= PANE_RESIZE;
 }
 
+/*
+ * Reflow history left at an old width by resizing. This is put off until
+ * something needs the history, so a run of resizes only reflows it once.
+ */
+void
+window_pane_reflow_history(struct window_pane *wp)
+{
+	if (wp->base.grid->hreflow == 0)
+		return;
+	grid_reflow_history(wp->base.grid);
+	window_pane_freeze_history(wp);
+}
+
+/* Compress or spill old history lines if enabled. */
+void
+window_pane_freeze_history(struct window_pane *wp)
+{
+	struct options	*oo = &wp->window->options;
+	struct grid	*gd = wp->base.grid;
+	u_int		 hot, spill;
+	char		*path;
+
+	hot = options_get_number(oo, "history-hot-limit");
+	spill = options_get_number(oo, "history-spill-limit");
+
+	/*
+	 * Create the spill file when first needed. It is removed straight away
+	 * so it goes when the grid is destroyed or the server exits. If it
+	 * cannot be created, the history stays in memory.
+	 */
+	if (spill != 0 && gd->spillfd == -1 && (~gd->flags & GRID_NOSPILL) &&
+	    gd->hsize > spill) {
+		xasprintf(&path, "%s-%u.history.XXXXXXXX", socket_path, wp->id);
+		gd->spillfd = mkstemp(path);
+		if (gd->spillfd == -1) {
+			log_debug("%s: %s", path, strerror(errno));
+			gd->flags |= GRID_NOSPILL;
+		} else {
+			unlink(path);
+			fcntl(gd->spillfd, F_SETFD, FD_CLOEXEC);
+		}
+		free(path);
+	}
+
+	grid_freeze_history(gd, hot, spill);
+}
+
 /*
  * Enter alternative screen mode. A copy of the visible screen is saved and the
  * history is not updated
@@ -1047,6 +1138,7 @@ window_pane_set_mode(struct window_pane *wp, const struct window_mode *mode)
 	if ((s = wp->mode->init(wp)) != NULL)
 		wp->screen = s;
 	wp->flags |= PANE_REDRAW;
+	queue_window_name(wp->window);
 	return (0);
 }
 
@@ -1061,6 +1153,7 @@ window_pane_reset_mode(struct window_pane *wp)
 
 	wp->screen = &wp->base;
 	wp->flags |= PANE_REDRAW;
+	queue_window_name(wp->window);
 }
 
 void
@@ -1124,6 +1217,27 @@ window_pane_visible(struct window_pane *wp)
 	return (1);
 }
 
+/* Mark lines of a pane as needing redrawn. */
+void
+window_pane_dirty(struct window_pane *wp, u_int upper, u_int lower)
+{
+	if (lower > wp->sy - 1)
+		lower = wp->sy - 1;
+	if (upper > lower)
+		return;
+
+	if (wp->flags & PANE_DIRTY) {
+		if (upper < wp->dirty_upper)
+			wp->dirty_upper = upper;
+		if (lower > wp->dirty_lower)
+			wp->dirty_lower = lower;
+		return;
+	}
+	wp->dirty_upper = upper;
+	wp->dirty_lower = lower;
+	wp->flags |= PANE_DIRTY;
+}
+
 char *
 window_pane_search(struct window_pane *wp, const char *searchstr,
     u_int *lineno)
@@ -1350,25 +1464,16 @@ winlink_clear_flags(struct winlink *wl)
 {
 	struct winlink	*wm;
 	struct session	*s;
-	struct window	*w;
-	u_int		 i;
+	struct window	*w = wl->window;
 
-	for (i = 0; i < ARRAY_LENGTH(&windows); i++) {
-		if ((w = ARRAY_ITEM(&windows, i)) == NULL)
+	RB_FOREACH(s, sessions, &sessions) {
+		if ((wm = session_has(s, w)) == NULL)
+			continue;
+		if ((wm->flags & WINLINK_ALERTFLAGS) == 0)
 			continue;
 
-		RB_FOREACH(s, sessions, &sessions) {
-			if ((wm = session_has(s, w)) == NULL)
-				continue;
-
-			if (wm->window != wl->window)
-				continue;
-			if ((wm->flags & WINLINK_ALERTFLAGS) == 0)
-				continue;
-
-			wm->flags &= ~WINLINK_ALERTFLAGS;
-			wm->window->flags &= ~WINDOW_ALERTFLAGS;
-			server_status_session(s);
-		}
+		wm->flags &= ~WINLINK_ALERTFLAGS;
+		w->flags &= ~WINDOW_ALERTFLAGS;
+		server_status_session(s);
 	}
 }